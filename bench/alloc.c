@@ -0,0 +1,29 @@
+// Count heap allocations by wrapping the glibc allocator entry points.
+#include "workload.h"
+
+#include <stdlib.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static size_t allocs = 0;
+
+void *malloc(size_t size) {
+	allocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+	allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	allocs++;
+	return __libc_realloc(ptr, size);
+}
+
+size_t alloc_count(void) {
+	return allocs;
+}
@@ -0,0 +1,108 @@
+// Benchmark direction classification, comparing the comparison based
+// classifier against the angle based one and checking that both agree.
+#include "libinput-touchscreen.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define VECTORS 1000000
+#define DIAGONAL_EPS 1e-4  // angles this close to a boundary may round differently
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static float random_coord(void) {
+	// mix in exact axis and diagonal vectors, which hit the boundaries
+	switch (rand() % 8) {
+	case 0:
+		return 0;
+	case 1:
+		return 5;
+	case 2:
+		return -5;
+	default:
+		return (rand() / (float)RAND_MAX - 0.5) * 200;
+	}
+}
+
+// distance of the vector angle to the closest 4 direction boundary
+static double boundary_distance(float dx, float dy) {
+	double a = atan2(-dy, dx), d = fmod(fabs(a) + M_PI / 4, M_PI / 2);
+	return fmin(d, M_PI / 2 - d);
+}
+
+// compare against the angle based classifier, the only 8 direction property
+// checked is that diagonals stay within their neighbouring main directions
+static size_t check(const float *dx, const float *dy, size_t n) {
+	size_t mismatches = 0;
+	movement m = {0};
+	enum DIRECTION old, new;
+	for (size_t i = 0; i < n; i++) {
+		m.end = (vec2){dx[i], dy[i]};
+		old = angle_to_direction(movement_angle(&m));
+		set_direction_mode(4, 0);
+		new = vector_direction(dx[i], dy[i]);
+		if (new != old && (new == DIR_NONE || old == DIR_NONE ||
+		                   boundary_distance(dx[i], dy[i]) > DIAGONAL_EPS)) {
+			if (mismatches++ < 5) {
+				printf("mismatch %f %f: angle %d, vector %d\n", dx[i], dy[i], old, new);
+			}
+		}
+		set_direction_mode(8, 0);
+		new = vector_direction(dx[i], dy[i]);
+		if (new == DIR_NONE ? old != DIR_NONE : (new == DIR_TOP_RIGHT || new == DIR_BOT_RIGHT) ?
+		    old == DIR_LEFT : (new == DIR_TOP_LEFT || new == DIR_BOT_LEFT) ? old == DIR_RIGHT : false) {
+			if (mismatches++ < 5) {
+				printf("mismatch %f %f: angle %d, 8 directions %d\n", dx[i], dy[i], old, new);
+			}
+		}
+	}
+	return mismatches;
+}
+
+int main(void) {
+	float *dx = calloc(VECTORS, sizeof *dx), *dy = calloc(VECTORS, sizeof *dy);
+	uint8_t *dirs = calloc(VECTORS, sizeof *dirs);
+	movement m = {0};
+	size_t sum = 0, mismatches;
+	uint64_t t0, t1, t2, t3, t4;
+
+	srand(1);
+	for (size_t i = 0; i < VECTORS; i++) {
+		dx[i] = random_coord();
+		dy[i] = random_coord();
+	}
+	mismatches = check(dx, dy, VECTORS);
+
+	t0 = now_ns();
+	for (size_t i = 0; i < VECTORS; i++) {
+		m.end = (vec2){dx[i], dy[i]};
+		sum += angle_to_direction(movement_angle(&m));
+	}
+	t1 = now_ns();
+	set_direction_mode(4, 0);
+	for (size_t i = 0; i < VECTORS; i++) {
+		sum += vector_direction(dx[i], dy[i]);
+	}
+	t2 = now_ns();
+	classify_directions(dx, dy, VECTORS, dirs);
+	t3 = now_ns();
+	set_direction_mode(8, 0);
+	classify_directions(dx, dy, VECTORS, dirs);
+	t4 = now_ns();
+	sum += dirs[0];
+
+	printf("angle %.2f ns/vector, vector %.2f ns/vector, batched %.2f ns/vector, batched 8-way %.2f ns/vector\n",
+	       (double)(t1 - t0) / VECTORS, (double)(t2 - t1) / VECTORS,
+	       (double)(t3 - t2) / VECTORS, (double)(t4 - t3) / VECTORS);
+	printf("%lu vectors, %lu mismatches (checksum %lu)\n", (size_t)VECTORS, mismatches, sum);
+	free(dx);
+	free(dy);
+	free(dirs);
+	return mismatches > 0;
+}
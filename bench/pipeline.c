@@ -0,0 +1,331 @@
+// Benchmark the recognizer stages on synthetic workloads, reporting time
+// and heap allocations per event and per gesture for each stage. A replayed
+// session then feeds a capture through the whole per-frame path of the
+// daemon, which must not allocate once warmed up.
+#include "libinput-touchscreen.h"
+#include "capture.h"
+#include "configuration.h"
+#include "evdev-backend.h"
+#include "gesture.h"
+#include "ruleset.h"
+#include "touchdevice.h"
+#include "update.h"
+#include "workload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SESSION_PASSES 5  // replays of the session counted after the warm-up pass
+
+enum STAGE {
+	ST_TOUCH,  // handle_touch, per event
+	ST_READY,  // get_ready_movements
+	ST_DIRECTION,  // movement_direction
+	ST_BORDER,  // movement_border_direction
+	ST_MATCH,  // ruleset_match
+	ST_NUM,
+};
+
+static const char *stage_names[ST_NUM] = {"touch", "ready", "direction", "border", "match"};
+
+typedef struct stage {
+	uint64_t ns;
+	size_t allocs;
+} stage;
+
+static uint64_t clock_overhead = 0;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void calibrate_clock(void) {
+	uint64_t start = now_ns();
+	for (int i = 0; i < 100000; i++) {
+		now_ns();
+	}
+	clock_overhead = (now_ns() - start) / 100000;
+}
+
+// account time and allocations since t0/a0 to a stage
+static void stage_add(stage *s, uint64_t t0, size_t a0) {
+	uint64_t dt = now_ns() - t0;
+	s->ns += dt > clock_overhead ? dt - clock_overhead : 0;
+	s->allocs += alloc_count() - a0;
+}
+
+// returns number of allocations in the recognizer, expected to be zero
+static size_t run(const workload_params *p, movement *screen, const ruleset *rules) {
+	slots *touches = slots_new(MAX_SLOTS);
+	stage stages[ST_NUM] = {{0}};
+	workload *w = workload_generate(p, screen);
+	const touch_record *t;
+	slotmask ready;
+	gesture g;
+	size_t gestures = 0, matched = 0, allocs = 0, a0;
+	uint64_t t0;
+
+	for (size_t i = 0; i < w->len; i++) {
+		t = w->records + i;
+		a0 = alloc_count();
+		t0 = now_ns();
+		handle_touch(t, touches);
+		stage_add(stages + ST_TOUCH, t0, a0);
+		if (t->type != TT_FRAME || any_down(touches)) {
+			continue;
+		}
+
+		a0 = alloc_count();
+		t0 = now_ns();
+		ready = get_ready_movements(touches);
+		stage_add(stages + ST_READY, t0, a0);
+		if (ready == 0) {
+			continue;
+		}
+		gestures++;
+
+		a0 = alloc_count();
+		t0 = now_ns();
+		movement_direction(touches, ready);
+		stage_add(stages + ST_DIRECTION, t0, a0);
+
+		a0 = alloc_count();
+		t0 = now_ns();
+		movement_border_direction(touches, ready, screen);
+		stage_add(stages + ST_BORDER, t0, a0);
+
+		g = get_gesture(touches, screen, ready);
+		a0 = alloc_count();
+		t0 = now_ns();
+		matched += ruleset_match(rules, &g) != NULL;
+		stage_add(stages + ST_MATCH, t0, a0);
+	}
+
+	for (int s = 0; s < ST_NUM; s++) {
+		printf("%7lu %5.0f %6.1f %-10s", p->fingers, p->rate, p->length, stage_names[s]);
+		if (s == ST_TOUCH) {
+			printf(" %9.1f", (double)stages[s].ns / w->len);
+		} else {
+			printf(" %9s", "-");
+		}
+		printf(" %10.1f %8.2f\n", gestures ? (double)stages[s].ns / gestures : 0,
+		       gestures ? (double)stages[s].allocs / gestures : 0);
+		allocs += stages[s].allocs;
+	}
+	logger("%lu of %lu gestures matched\n", matched, gestures);
+	workload_destroy(w);
+	slots_destroy(touches);
+	return allocs;
+}
+
+// write a generated workload as capture file for the replay tool
+static int write_capture(const workload_params *p, movement *screen, const char *path) {
+	workload *w = workload_generate(p, screen);
+	if (!capture_start(path)) {
+		return 1;
+	}
+	for (size_t i = 0; i < w->len; i++) {
+		capture_write(w->records + i);
+	}
+	capture_stop();
+	printf("Wrote %lu events, %lu gestures\n", w->len, w->gestures);
+	workload_destroy(w);
+	return 0;
+}
+
+// Feed one pass of a capture through the device and the frame handler of
+// the daemon, shifted by offset us, returns the number of gestures. Hold
+// timers and rate limited updates run at the recorded times.
+static size_t session_pass(const capture *c, touch_device *d, const ruleset *rules, uint64_t offset) {
+	char command[sizeof ((rule *)0)->command + 32];
+	touch_record t;
+	const rule *r;
+	double delta;
+	gesture g;
+	size_t gestures = 0;
+	for (size_t i = 0; i < c->len; i++) {
+		t = c->records[i];
+		t.time += offset;
+		t.device = d->index;
+		if (hold_deadline(d->touches, rules) <= t.time && handle_hold(d->touches, &d->screen, rules, t.time, &g)) {
+			gestures += ruleset_match(rules, &g) != NULL;
+		}
+		while (update_next(t.time, &r, &delta)) {
+			update_command(command, sizeof command, r->command, delta);
+			ruleset_hit(rules, r);
+		}
+		device_record(d, &t);
+		if (t.type != TT_FRAME || prune_sequence(d->touches, &d->screen, rules)) {
+			continue;
+		}
+		if ((handle_streaming(d->touches, &d->screen, rules, &g) ||
+		     handle_movements(d->touches, &d->screen, rules, &g)) &&
+		    (r = ruleset_match(rules, &g)) != NULL) {
+			ruleset_hit(rules, r);
+			gestures++;
+		}
+		handle_continuous(d->touches, rules, &d->cont, t.time);
+	}
+	update_clear();
+	return gestures;
+}
+
+// replay a capture after a warm-up pass, returns allocations after it
+static size_t session(const capture *c, const ruleset *rules) {
+	touch_device *d = device_attach("bench", NULL, 0, 0, 273, 157.5, MAX_SLOTS);
+	uint64_t span, t0;
+	size_t gestures = 0, a0;
+	if (d == NULL || c->len == 0) {
+		return 0;
+	}
+	span = c->records[c->len - 1].time - c->records[0].time + 1000000;
+	session_pass(c, d, rules, 0);
+	a0 = alloc_count();
+	t0 = now_ns();
+	for (size_t i = 1; i <= SESSION_PASSES; i++) {
+		gestures += session_pass(c, d, rules, i * span);
+	}
+	t0 = now_ns() - t0;
+	a0 = alloc_count() - a0;
+	printf("session: %lu records x %d passes, %lu gestures, %.1f ns/event, %lu allocations\n", c->len,
+	       SESSION_PASSES, gestures, (double)t0 / (c->len * SESSION_PASSES), a0);
+	device_detach(d);
+	return a0;
+}
+
+// load a capture, an evemu recording or else the workload written as capture
+static capture *session_load(const char *path, bool evemu, const workload_params *p, movement *screen) {
+	char tmp[] = "/tmp/bench-pipeline-XXXXXX";
+	capture *c;
+	size_t events;
+	int fd;
+	if (evemu) {
+		c = calloc(1, sizeof *c);
+		if ((c->records = evdev_load_evemu(path, &events, &c->len)) == NULL) {
+			free(c);
+			return NULL;
+		}
+		return c;
+	}
+	if (path != NULL) {
+		return capture_open(path);
+	}
+	if ((fd = mkstemp(tmp)) == -1) {
+		printf("Failed to create a temporary capture\n");
+		return NULL;
+	}
+	close(fd);
+	c = write_capture(p, screen, tmp) == 0 ? capture_open(tmp) : NULL;
+	unlink(tmp);
+	return c;
+}
+
+void usage(const char *name) {
+	printf("Usage: %s [-f FINGERS] [-r RATE] [-l LENGTH] [-j JITTER] [-n GESTURES] [-w CAPTURE]\n", name);
+	printf("       [-s CAPTURE] [-e]\n");
+	printf("  without -f or -r a matrix of finger counts and rates is run\n");
+	printf("  -w CAPTURE  write the workload as capture instead of benchmarking\n");
+	printf("  -s CAPTURE  session to replay, the workload of -f and -r by default\n");
+	printf("  -e          the session is an evemu recording\n");
+}
+
+int main(int argc, char **argv) {
+	workload_params p = {.length = 80, .jitter = 0.5, .gestures = 2000, .seed = 1};
+	size_t fingers[] = {1, 2, 3, 5, 10, 40};
+	double rates[] = {60, 120, 240, 480};
+	const char *capture = NULL, *replayed = NULL;
+	bool matrix = true, evemu = false;
+	size_t allocs = 0, a;
+	struct capture *c;
+	int opt;
+	while ((opt = getopt(argc, argv, "f:r:l:j:n:w:s:eh")) != -1) {
+		switch (opt) {
+		case 'f':
+			p.fingers = strtoul(optarg, NULL, 10);
+			matrix = false;
+			break;
+		case 'r':
+			p.rate = strtod(optarg, NULL);
+			matrix = false;
+			break;
+		case 'l':
+			p.length = strtod(optarg, NULL);
+			break;
+		case 'j':
+			p.jitter = strtod(optarg, NULL);
+			break;
+		case 'n':
+			p.gestures = strtoul(optarg, NULL, 10);
+			break;
+		case 'w':
+			capture = optarg;
+			break;
+		case 's':
+			replayed = optarg;
+			break;
+		case 'e':
+			evemu = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	movement screen = {.start = {0, 0}, .end = {273, 157.5}};
+	settings s = {0};
+	list *rulelist = load_rules(CONFIG_PATH, &s);
+	ruleset *rules = ruleset_compile(rulelist);
+	if (rulelist != NULL) {
+		list_destroy(rulelist);
+	}
+
+	if (!matrix || capture != NULL) {
+		p.fingers = p.fingers ? p.fingers : 3;
+		p.rate = p.rate ? p.rate : 120;
+	}
+	if (capture != NULL) {
+		return write_capture(&p, &screen, capture);
+	}
+
+	calibrate_clock();
+	printf("%7s %5s %6s %-10s %9s %10s %8s\n", "fingers", "rate", "length", "stage", "ns/event", "ns/gesture", "allocs/g");
+	if (!matrix) {
+		allocs += run(&p, &screen, rules);
+	} else {
+		for (size_t f = 0; f < sizeof fingers / sizeof *fingers; f++) {
+			for (size_t r = 0; r < sizeof rates / sizeof *rates; r++) {
+				p.fingers = fingers[f];
+				p.rate = rates[r];
+				allocs += run(&p, &screen, rules);
+			}
+		}
+	}
+	if (allocs > 0) {
+		printf("FAIL: %lu allocations while recognizing gestures\n", allocs);
+	}
+
+	p.fingers = matrix ? 3 : p.fingers;
+	p.rate = matrix ? 120 : p.rate;
+	if ((c = session_load(replayed, evemu, &p, &screen)) == NULL) {
+		ruleset_destroy(rules);
+		return 1;
+	}
+	// the recognizer must not allocate once running
+	if ((a = session(c, rules)) > 0) {
+		printf("FAIL: %lu allocations in the replayed session\n", a);
+	}
+	if (evemu) {
+		free((void *)c->records);
+		free(c);
+	} else {
+		capture_close(c);
+	}
+	ruleset_destroy(rules);
+	return allocs > 0 || a > 0;
+}
@@ -0,0 +1,155 @@
+// Measure the latency from writing the touch up of a gesture until its rule
+// matched, with the recognizer woken through a pipe like by the input fd.
+// Threads spinning on all CPUs compete with the recognizer, which runs first
+// at normal priority and then in real-time mode.
+#include "libinput-touchscreen.h"
+#include "gesture.h"
+#include "realtime.h"
+#include "ruleset.h"
+#include "trace.h"
+#include "workload.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAME_INTERVAL 1000  // us between frames written by the producer
+
+typedef struct producer {
+	const workload *w;
+	int fd;
+} producer;
+
+static atomic_bool loaded = true;
+
+static void *spin(void *arg) {
+	volatile uint64_t n = 0;
+	realtime_background();
+	while (atomic_load_explicit(&loaded, memory_order_relaxed)) {
+		n++;
+	}
+	return NULL;
+}
+
+// write the records frame by frame, stamped with the time of the write
+static void *produce(void *arg) {
+	producer *p = arg;
+	struct timespec interval = {.tv_nsec = FRAME_INTERVAL * 1000};
+	touch_record frame[MAX_SLOTS + 1];
+	size_t n = 0;
+	realtime_background();
+	for (size_t i = 0; i < p->w->len; i++) {
+		frame[n++] = p->w->records[i];
+		if (p->w->records[i].type != TT_FRAME) {
+			continue;
+		}
+		for (size_t j = 0; j < n; j++) {
+			frame[j].time = trace_now();
+		}
+		write(p->fd, frame, n * sizeof *frame);
+		n = 0;
+		nanosleep(&interval, NULL);
+	}
+	close(p->fd);
+	return NULL;
+}
+
+static int compare(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+// recognize all gestures of the workload, returns the number matched
+static size_t run(const char *mode, const workload *w, movement *screen, const ruleset *rules) {
+	slots *touches = slots_new(MAX_SLOTS);
+	uint64_t *latency = calloc(w->gestures, sizeof *latency);
+	touch_record buf[64], *t;
+	ssize_t n;
+	producer p = {.w = w};
+	pthread_t thread;
+	struct pollfd pfd = {.events = POLLIN};
+	size_t matched = 0;
+	gesture g;
+	int fds[2];
+	pipe(fds);
+	pfd.fd = fds[0];
+	p.fd = fds[1];
+	pthread_create(&thread, NULL, produce, &p);
+	// frames are written at once, so reads never split a record
+	while (poll(&pfd, 1, -1) > 0 && (n = read(fds[0], buf, sizeof buf)) > 0) {
+		for (t = buf; t < buf + n / sizeof *buf; t++) {
+			handle_touch(t, touches);
+			if (t->type == TT_FRAME && handle_movements(touches, screen, rules, &g) &&
+			    ruleset_match(rules, &g) != NULL && matched < w->gestures) {
+				latency[matched++] = trace_now() - t->time;
+			}
+		}
+	}
+	pthread_join(thread, NULL);
+	close(fds[0]);
+	qsort(latency, matched, sizeof *latency, compare);
+	printf("%-10s %8lu %8lu %8lu %8lu\n", mode, matched, matched ? latency[matched / 2] : 0,
+	       matched ? latency[matched * 99 / 100] : 0, matched ? latency[matched - 1] : 0);
+	free(latency);
+	slots_destroy(touches);
+	return matched;
+}
+
+void usage(const char *name) {
+	printf("Usage: %s [-l THREADS] [-n GESTURES] [-R PRIORITY[,CPU]]\n", name);
+	printf("  -l THREADS  spinning load threads, one per CPU by default\n");
+	printf("  -R PRIO,CPU real-time priority and CPU of the second run, 50 by default\n");
+}
+
+int main(int argc, char **argv) {
+	workload_params wp = {.fingers = 3, .length = 20, .rate = 120, .gestures = 500, .seed = 1};
+	movement screen = {.start = {0, 0}, .end = {273, 157.5}};
+	rule r = {.key = {.type = GT_MOVEMENT, .num = 1}, .maxnum = RULE_MAX_FINGERS, .anydir = true};
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int priority = 50, cpu = -1, opt;
+	pthread_t *load;
+	while ((opt = getopt(argc, argv, "l:n:R:h")) != -1) {
+		switch (opt) {
+		case 'l':
+			threads = strtol(optarg, NULL, 10);
+			break;
+		case 'n':
+			wp.gestures = strtoul(optarg, NULL, 10);
+			break;
+		case 'R':
+			sscanf(optarg, "%d,%d", &priority, &cpu);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	list *rulelist = list_new(&r, sizeof r);
+	ruleset *rules = ruleset_compile(rulelist);
+	list_destroy(rulelist);
+	workload *w = workload_generate(&wp, &screen);
+	load = calloc(threads, sizeof *load);
+	for (long i = 0; i < threads; i++) {
+		pthread_create(load + i, NULL, spin, NULL);
+	}
+
+	printf("%ld load threads, %lu gestures, latency in us\n", threads, w->gestures);
+	printf("%-10s %8s %8s %8s %8s\n", "mode", "matched", "p50", "p99", "max");
+	run("normal", w, &screen, rules);
+	realtime_start(priority, cpu);
+	run(realtime_active() ? "realtime" : "no-rt", w, &screen, rules);
+
+	atomic_store(&loaded, false);
+	for (long i = 0; i < threads; i++) {
+		pthread_join(load[i], NULL);
+	}
+	free(load);
+	workload_destroy(w);
+	ruleset_destroy(rules);
+	return 0;
+}
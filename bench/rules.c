@@ -0,0 +1,98 @@
+// Benchmark rule matching for small and large generated rule sets, comparing
+// the compiled dispatch table against a linear scan of the rules.
+#include "libinput-touchscreen.h"
+#include "ruleset.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define LOOKUPS 1000000
+#define LINEAR_LOOKUPS 20000  // the linear scan gets too slow for LOOKUPS
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// reference matcher, first highest priority rule in config order
+static const rule *match_linear(const ruleset *rs, const gesture *g) {
+	const rule *best = NULL, *r;
+	for (size_t i = 0; i < rs->len; i++) {
+		r = rs->rules + i;
+		if (r->key.type != g->type || g->num < r->key.num || g->num > r->maxnum) {
+			continue;
+		}
+		if (!r->anydir && r->key.dir != g->dir) {
+			continue;
+		}
+		if (best == NULL || r->priority > best->priority) {
+			best = r;
+		}
+	}
+	return best;
+}
+
+static list *generate_rules(size_t n) {
+	list *l = NULL;
+	rule r;
+	for (size_t i = 0; i < n; i++) {
+		r = (rule){0};
+		r.key.type = 1 + rand() % (RULE_TYPES - 1);
+		r.key.dir = rand() % RULE_DIRS;
+		r.anydir = rand() % 10 == 0;
+		r.key.num = 1 + rand() % RULE_MAX_FINGERS;
+		r.maxnum = r.key.num + rand() % (RULE_MAX_FINGERS - r.key.num + 1);
+		r.priority = rand() % 4;
+		snprintf(r.command, sizeof r.command, "rule %lu", i);
+		if (l == NULL) {
+			l = list_new(&r, sizeof r);
+		} else {
+			list_append(l, &r, sizeof r);
+		}
+	}
+	return l;
+}
+
+static void bench(size_t nrules) {
+	gesture *gestures = calloc(LOOKUPS, sizeof *gestures);
+	list *l = generate_rules(nrules);
+	ruleset *rs = ruleset_compile(l);
+	size_t hits = 0, mismatches = 0;
+	uint64_t t0, t1, t2;
+
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		gestures[i].type = 1 + rand() % (RULE_TYPES - 1);
+		gestures[i].dir = rand() % RULE_DIRS;
+		gestures[i].num = 1 + rand() % RULE_MAX_FINGERS;
+	}
+
+	t0 = now_ns();
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		hits += ruleset_match(rs, gestures + i) != NULL;
+	}
+	t1 = now_ns();
+	for (size_t i = 0; i < LINEAR_LOOKUPS; i++) {
+		hits += match_linear(rs, gestures + i) != NULL;
+	}
+	t2 = now_ns();
+	for (size_t i = 0; i < LINEAR_LOOKUPS; i++) {
+		mismatches += ruleset_match(rs, gestures + i) != match_linear(rs, gestures + i);
+	}
+
+	printf("%6lu rules: table %6.1f ns/match, linear %9.1f ns/match, %lu hits, %lu mismatches\n",
+	       nrules, (double)(t1 - t0) / LOOKUPS, (double)(t2 - t1) / LINEAR_LOOKUPS, hits, mismatches);
+	ruleset_destroy(rs);
+	list_destroy(l);
+	free(gestures);
+}
+
+int main(void) {
+	srand(1);
+	bench(5);
+	bench(50);
+	bench(500);
+	bench(5000);
+	return 0;
+}
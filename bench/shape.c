@@ -0,0 +1,80 @@
+// Benchmark shape recognition against dozens of templates, reporting the
+// time per resampled stroke and per match and the recognition rate of
+// noisy, scaled and shifted copies of the templates.
+#include "libinput-touchscreen.h"
+#include "shape.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TEMPLATES 48
+#define CORNERS 5  // corners of the random polyline templates
+#define STROKES 20000
+#define STROKE_STEP 1.0f  // distance between recorded points in mm
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static float frand(float min, float max) {
+	return min + (max - min) * rand() / (float)RAND_MAX;
+}
+
+// sample a polyline densely like the slot trail does, with noise
+static size_t draw(const float *cx, const float *cy, float scale, float noise, float *x, float *y) {
+	float ox = frand(0, 100), oy = frand(0, 100), len, t;
+	size_t n = 0;
+	for (size_t c = 1; c < CORNERS && n < SLOT_TRAIL; c++) {
+		len = hypotf(cx[c] - cx[c - 1], cy[c] - cy[c - 1]) * scale;
+		for (t = 0; t < len && n < SLOT_TRAIL; t += STROKE_STEP) {
+			x[n] = ox + (cx[c - 1] + (cx[c] - cx[c - 1]) * t / len) * scale + frand(-noise, noise);
+			y[n] = oy + (cy[c - 1] + (cy[c] - cy[c - 1]) * t / len) * scale + frand(-noise, noise);
+			n++;
+		}
+	}
+	return n;
+}
+
+int main(void) {
+	float cx[TEMPLATES][CORNERS], cy[TEMPLATES][CORNERS], x[SLOT_TRAIL], y[SLOT_TRAIL];
+	shape templates[TEMPLATES], *strokes = calloc(STROKES, sizeof *strokes);
+	int *expected = calloc(STROKES, sizeof *expected);
+	size_t n, correct = 0, rejected = 0;
+	uint64_t t0, resample = 0, match;
+
+	srand(1);
+	for (size_t i = 0; i < TEMPLATES; i++) {
+		for (size_t c = 0; c < CORNERS; c++) {
+			cx[i][c] = frand(0, 1);
+			cy[i][c] = frand(0, 1);
+		}
+		n = draw(cx[i], cy[i], 40, 0, x, y);
+		shape_from_path(x, y, n, templates + i);
+	}
+
+	for (size_t i = 0; i < STROKES; i++) {
+		expected[i] = rand() % TEMPLATES;
+		n = draw(cx[expected[i]], cy[expected[i]], frand(20, 40), 0.5, x, y);
+		t0 = now_ns();
+		shape_from_path(x, y, n, strokes + i);
+		resample += now_ns() - t0;
+	}
+	t0 = now_ns();
+	for (size_t i = 0; i < STROKES; i++) {
+		int m = shape_match(strokes + i, templates, TEMPLATES);
+		correct += m == expected[i];
+		rejected += m < 0;
+	}
+	match = now_ns() - t0;
+
+	printf("%d templates: resample %.1f ns/stroke, match %.1f ns/stroke, %.1f%% correct, %.1f%% rejected\n",
+	       TEMPLATES, (double)resample / STROKES, (double)match / STROKES,
+	       100.0 * correct / STROKES, 100.0 * rejected / STROKES);
+	free(strokes);
+	free(expected);
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include "workload.h"
+
+#include <stdlib.h>
+
+#define SWIPE_SPEED 300.0  // finger speed in mm/s
+#define FINGER_SPACING 12.0  // distance between neighbouring fingers in mm
+#define GESTURE_GAP 200000  // pause between gestures in us
+
+static double jitter(double max) {
+	return max * (2.0 * rand() / RAND_MAX - 1.0);
+}
+
+static void push(workload *w, size_t *cap, touch_record t) {
+	if (w->len == *cap) {
+		*cap = *cap ? *cap * 2 : 4096;
+		w->records = realloc(w->records, *cap * sizeof *w->records);
+	}
+	w->records[w->len++] = t;
+}
+
+workload *workload_generate(const workload_params *p, const movement *screen) {
+	workload *w = calloc(1, sizeof *w);
+	size_t cap = 0, frames, fingers = p->fingers;
+	uint64_t time = 1000000, frametime = 1e6 / p->rate;
+	double width = screen->end.x - screen->start.x;
+	double height = screen->end.y - screen->start.y;
+	vec2 start, dir, spread;
+
+	if (fingers > MAX_SLOTS) {
+		fingers = MAX_SLOTS;
+	}
+	srand(p->seed);
+	frames = p->length / SWIPE_SPEED * p->rate;
+	for (size_t g = 0; g < p->gestures; g++) {
+		// pick one of the four directions, fingers lined up across it
+		switch (rand() % 4) {
+		case 0: dir = (vec2){1, 0}; break;
+		case 1: dir = (vec2){-1, 0}; break;
+		case 2: dir = (vec2){0, 1}; break;
+		default: dir = (vec2){0, -1}; break;
+		}
+		spread = (vec2){dir.y, dir.x};
+		start.x = screen->start.x + width / 2 - dir.x * p->length / 2;
+		start.y = screen->start.y + height / 2 - dir.y * p->length / 2;
+		start.x -= spread.x * FINGER_SPACING * (fingers - 1) / 2;
+		start.y -= spread.y * FINGER_SPACING * (fingers - 1) / 2;
+
+		for (size_t f = 0; f < fingers; f++) {
+			push(w, &cap, (touch_record){
+				.time = time, .type = TT_DOWN, .slot = f,
+				.x = start.x + spread.x * FINGER_SPACING * f,
+				.y = start.y + spread.y * FINGER_SPACING * f});
+		}
+		push(w, &cap, (touch_record){.time = time, .type = TT_FRAME});
+		for (size_t i = 1; i <= frames; i++) {
+			time += frametime;
+			for (size_t f = 0; f < fingers; f++) {
+				double d = p->length * i / frames;
+				push(w, &cap, (touch_record){
+					.time = time, .type = TT_MOTION, .slot = f,
+					.x = start.x + spread.x * FINGER_SPACING * f + dir.x * d + jitter(p->jitter),
+					.y = start.y + spread.y * FINGER_SPACING * f + dir.y * d + jitter(p->jitter)});
+			}
+			push(w, &cap, (touch_record){.time = time, .type = TT_FRAME});
+		}
+		time += frametime;
+		for (size_t f = 0; f < fingers; f++) {
+			push(w, &cap, (touch_record){.time = time, .type = TT_UP, .slot = f});
+		}
+		push(w, &cap, (touch_record){.time = time, .type = TT_FRAME});
+		time += GESTURE_GAP;
+		w->gestures++;
+	}
+	return w;
+}
+
+void workload_destroy(workload *w) {
+	free(w->records);
+	free(w);
+}
@@ -0,0 +1,29 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+#include "libinput-touchscreen.h"
+#include <stddef.h>
+
+// parameters of a synthetic touch workload
+typedef struct workload_params {
+	size_t fingers;  // simultaneous fingers per gesture, up to MAX_SLOTS
+	double length;  // swipe length in mm, 0 for taps
+	double jitter;  // maximum random offset per motion event in mm
+	double rate;  // digitizer frame rate in Hz
+	size_t gestures;  // number of gestures to generate
+	unsigned int seed;
+} workload_params;
+
+typedef struct workload {
+	touch_record *records;
+	size_t len;
+	size_t gestures;
+} workload;
+
+// Generate touch records for swipes in random directions
+workload *workload_generate(const workload_params *p, const movement *screen);
+// Free generated workload
+void workload_destroy(workload *w);
+
+// Number of allocations made by the process so far
+size_t alloc_count(void);
+#endif
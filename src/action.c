@@ -0,0 +1,67 @@
+#include "action.h"
+#include "bus.h"
+#include "executor.h"
+#include "uinput-device.h"
+
+#include <string.h>
+
+static bool has_prefix(const char *action, const char *prefix) {
+	return strncmp(action, prefix, strlen(prefix)) == 0;
+}
+
+static bool is_uinput(const char *action) {
+	return has_prefix(action, ACTION_KEY) || has_prefix(action, ACTION_CLICK) ||
+	       has_prefix(action, ACTION_SCROLL);
+}
+
+bool action_check(const char *action) {
+	if (has_prefix(action, ACTION_DBUS)) {
+		return bus_check(action + strlen(ACTION_DBUS));
+	}
+	if (has_prefix(action, ACTION_KEY)) {
+		return uinput_check_key(action + strlen(ACTION_KEY));
+	}
+	if (has_prefix(action, ACTION_CLICK)) {
+		return uinput_check_click(action + strlen(ACTION_CLICK));
+	}
+	if (has_prefix(action, ACTION_SCROLL)) {
+		return uinput_check_scroll(action + strlen(ACTION_SCROLL));
+	}
+	return true;
+}
+
+void action_prepare(const ruleset *rules) {
+	bool dbus = false, uinput = false;
+	for (size_t i = 0; i < rules->len; i++) {
+		dbus |= has_prefix(rules->rules[i].command, ACTION_DBUS);
+		uinput |= is_uinput(rules->rules[i].command);
+	}
+	if (dbus) {
+		bus_connect();
+	}
+	// created ahead of the first action, so that it is known when it fires
+	if (uinput) {
+		uinput_open();
+	}
+}
+
+int action_run(const char *action, uint32_t timeout) {
+	if (has_prefix(action, ACTION_DBUS)) {
+		return bus_call(action + strlen(ACTION_DBUS));
+	}
+	if (has_prefix(action, ACTION_KEY)) {
+		return uinput_key(action + strlen(ACTION_KEY));
+	}
+	if (has_prefix(action, ACTION_CLICK)) {
+		return uinput_click(action + strlen(ACTION_CLICK));
+	}
+	if (has_prefix(action, ACTION_SCROLL)) {
+		return uinput_scroll(action + strlen(ACTION_SCROLL));
+	}
+	return executor_spawn(action, timeout);
+}
+
+void action_close(void) {
+	bus_disconnect();
+	uinput_close();
+}
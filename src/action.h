@@ -0,0 +1,21 @@
+#ifndef ACTION_H
+#define ACTION_H
+#include "ruleset.h"
+#include <stdint.h>
+#define ACTION_DBUS "dbus:"  // prefix of session bus method call actions
+#define ACTION_KEY "key:"  // prefix of synthetic key combo actions
+#define ACTION_CLICK "click:"  // prefix of synthetic button click actions
+#define ACTION_SCROLL "scroll:"  // prefix of synthetic scroll actions
+
+// Actions are shell commands launched through the executor, unless they
+// start with one of the prefixes above and run inside the daemon.
+
+// Check that an in-daemon action is well formed, false with a message
+bool action_check(const char *action);
+// Open connections and devices needed by the actions of the rules
+void action_prepare(const ruleset *rules);
+// Run an action, kill commands after timeout ms (0 = never), -1 on errors
+int action_run(const char *action, uint32_t timeout);
+// Close connections and devices of actions
+void action_close(void);
+#endif
@@ -0,0 +1,42 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+#include "touchdevice.h"
+#include <stddef.h>
+
+// Called after a touch frame of a device was fed into its slots
+typedef void (*frame_handler)(touch_device *d, void *data);
+
+// Receiver of the touch records of a backend read on another thread than
+// the recognizer. Devices are only attached or detached between lock and
+// unlock, which wait for the recognizer to be idle.
+typedef struct record_sink {
+	record_handler record;  // touch record of an attached device
+	void (*lock)(void *data);
+	void (*unlock)(void *data);
+	void *data;
+} record_sink;
+
+// Source of touch input. Backends turn their events into touch records of
+// touchscreens set up with device_attach, so everything from the slots on
+// is shared.
+typedef struct backend {
+	const char *name;
+	// Fd that becomes readable when input is pending
+	int (*fd)(struct backend *b);
+	// Read all pending input once, returns the number of events handled
+	size_t (*dispatch)(struct backend *b, frame_handler frame, void *data);
+	// Read all pending input once, passing touch records to sink instead of
+	// the slots. NULL if the backend cannot run on another thread.
+	size_t (*drain)(struct backend *b, const record_sink *sink);
+	// Detach devices and free the backend
+	void (*destroy)(struct backend *b);
+} backend;
+
+// All touchscreens of a udev seat through libinput, NULL on errors
+backend *libinput_backend_new(const char *seat);
+// A single multitouch device node read without libinput, NULL on errors
+backend *evdev_backend_new(const char *devpath);
+// Read inner on an ingestion thread and hand its touch records to the
+// recognizer through a ring, NULL on errors. Takes ownership of inner.
+backend *pipeline_backend_new(backend *inner);
+#endif
@@ -0,0 +1,193 @@
+#include "bus.h"
+#include "scheduler.h"
+
+#include <dbus/dbus.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static DBusConnection *conn = NULL;
+static uint64_t retry = UINT64_MAX;  // next reconnection attempt
+
+bool bus_connect(void) {
+	DBusError err;
+	if (conn != NULL) {
+		return true;
+	}
+	dbus_error_init(&err);
+	// private, so closing it on loss does not affect other users of libdbus
+	conn = dbus_bus_get_private(DBUS_BUS_SESSION, &err);
+	if (conn == NULL) {
+		printf("Failed to connect to session bus: %s\n", err.message);
+		dbus_error_free(&err);
+		retry = sched_now() + BUS_RETRY * 1000;
+		return false;
+	}
+	retry = UINT64_MAX;
+	dbus_connection_set_exit_on_disconnect(conn, FALSE);
+	return true;
+}
+
+uint64_t bus_deadline(void) {
+	return retry;
+}
+
+void bus_retry(uint64_t now) {
+	if (retry <= now) {
+		bus_connect();
+	}
+}
+
+int bus_fd(void) {
+	int fd;
+	if (conn == NULL || !dbus_connection_get_unix_fd(conn, &fd)) {
+		return -1;
+	}
+	return fd;
+}
+
+short bus_events(void) {
+	if (conn == NULL) {
+		return 0;
+	}
+	return POLLIN | (dbus_connection_has_messages_to_send(conn) ? POLLOUT : 0);
+}
+
+void bus_handle(void) {
+	if (conn == NULL) {
+		return;
+	}
+	// nonblocking, incoming messages are only signals and are dropped
+	dbus_connection_read_write(conn, 0);
+	while (dbus_connection_dispatch(conn) == DBUS_DISPATCH_DATA_REMAINS);
+	if (!dbus_connection_get_is_connected(conn)) {
+		printf("Session bus connection lost\n");
+		bus_disconnect();
+		retry = sched_now() + BUS_RETRY * 1000;
+	}
+}
+
+// append a <type>:<value> argument
+static bool append_arg(DBusMessage *msg, char *arg) {
+	char *value = strchr(arg, ':');
+	dbus_int32_t i32;
+	dbus_uint32_t u32;
+	dbus_int64_t i64;
+	dbus_uint64_t u64;
+	dbus_bool_t b;
+	double d;
+	if (value == NULL) {
+		return false;
+	}
+	*value++ = '\0';
+	// libdbus aborts on invalid strings and paths instead of failing
+	if (strcmp(arg, "string") == 0) {
+		return dbus_validate_utf8(value, NULL) &&
+		       dbus_message_append_args(msg, DBUS_TYPE_STRING, &value, DBUS_TYPE_INVALID);
+	}
+	if (strcmp(arg, "objpath") == 0) {
+		return dbus_validate_path(value, NULL) &&
+		       dbus_message_append_args(msg, DBUS_TYPE_OBJECT_PATH, &value, DBUS_TYPE_INVALID);
+	}
+	if (strcmp(arg, "int32") == 0) {
+		i32 = strtol(value, NULL, 0);
+		return dbus_message_append_args(msg, DBUS_TYPE_INT32, &i32, DBUS_TYPE_INVALID);
+	}
+	if (strcmp(arg, "uint32") == 0) {
+		u32 = strtoul(value, NULL, 0);
+		return dbus_message_append_args(msg, DBUS_TYPE_UINT32, &u32, DBUS_TYPE_INVALID);
+	}
+	if (strcmp(arg, "int64") == 0) {
+		i64 = strtoll(value, NULL, 0);
+		return dbus_message_append_args(msg, DBUS_TYPE_INT64, &i64, DBUS_TYPE_INVALID);
+	}
+	if (strcmp(arg, "uint64") == 0) {
+		u64 = strtoull(value, NULL, 0);
+		return dbus_message_append_args(msg, DBUS_TYPE_UINT64, &u64, DBUS_TYPE_INVALID);
+	}
+	if (strcmp(arg, "double") == 0) {
+		d = strtod(value, NULL);
+		return dbus_message_append_args(msg, DBUS_TYPE_DOUBLE, &d, DBUS_TYPE_INVALID);
+	}
+	if (strcmp(arg, "boolean") == 0) {
+		b = strcmp(value, "true") == 0;
+		return dbus_message_append_args(msg, DBUS_TYPE_BOOLEAN, &b, DBUS_TYPE_INVALID);
+	}
+	return false;
+}
+
+// build a method call message, NULL if the call is malformed
+static DBusMessage *parse_call(const char *call) {
+	char buffer[512], *dest, *path, *method, *iface, *arg, *save;
+	DBusMessage *msg;
+	snprintf(buffer, sizeof buffer, "%s", call);
+	dest = strtok_r(buffer, " \t", &save);
+	path = strtok_r(NULL, " \t", &save);
+	iface = strtok_r(NULL, " \t", &save);
+	if (iface == NULL || (method = strrchr(iface, '.')) == NULL) {
+		return NULL;
+	}
+	*method++ = '\0';
+	if (!dbus_validate_bus_name(dest, NULL) || !dbus_validate_path(path, NULL) ||
+	    !dbus_validate_interface(iface, NULL) || !dbus_validate_member(method, NULL)) {
+		return NULL;
+	}
+	if ((msg = dbus_message_new_method_call(dest, path, iface, method)) == NULL) {
+		return NULL;
+	}
+	for (size_t i = 0; (arg = strtok_r(NULL, " \t", &save)) != NULL; i++) {
+		if (i == BUS_MAX_ARGS || !append_arg(msg, arg)) {
+			dbus_message_unref(msg);
+			return NULL;
+		}
+	}
+	return msg;
+}
+
+bool bus_check(const char *call) {
+	DBusMessage *msg = parse_call(call);
+	if (msg == NULL) {
+		printf("Invalid bus call %s\n", call);
+		return false;
+	}
+	dbus_message_unref(msg);
+	return true;
+}
+
+int bus_call(const char *call) {
+	DBusMessage *msg = parse_call(call);
+	int ret = -1;
+	if (msg == NULL) {
+		printf("Invalid bus call %s\n", call);
+		return -1;
+	}
+	if (conn == NULL) {
+		printf("Session bus not connected, dropping call %s\n", call);
+		// reconnect from the poll loop, unless already waiting to
+		if (retry == UINT64_MAX) {
+			retry = sched_now();
+		}
+		dbus_message_unref(msg);
+		return -1;
+	}
+	// without a reply nothing waits for the callee
+	dbus_message_set_no_reply(msg, TRUE);
+	if (dbus_connection_send(conn, msg, NULL)) {
+		// write what the socket takes now, the rest once it polls writable
+		dbus_connection_read_write(conn, 0);
+		ret = 0;
+	}
+	dbus_message_unref(msg);
+	return ret;
+}
+
+void bus_disconnect(void) {
+	retry = UINT64_MAX;
+	if (conn == NULL) {
+		return;
+	}
+	dbus_connection_close(conn);
+	dbus_connection_unref(conn);
+	conn = NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef BUS_H
+#define BUS_H
+#include <stdbool.h>
+#include <stdint.h>
+#define BUS_MAX_ARGS 8  // most arguments of a method call
+#define BUS_RETRY 2000  // ms between attempts to reopen the connection
+
+// Method calls on the session bus over a single connection that stays open
+// for the lifetime of the daemon. Calls are queued without waiting for a
+// reply and written out from the poll loop. Connecting blocks, so a lost
+// connection is reopened from a timer instead of by a call, and calls are
+// dropped until then.
+
+// Connect to the session bus if not connected, false and retry later on errors
+bool bus_connect(void);
+// Time in monotonic us of the next reconnection attempt, UINT64_MAX if none
+uint64_t bus_deadline(void);
+// Reconnect if the attempt is due at now
+void bus_retry(uint64_t now);
+// Fd of the bus connection, -1 if not connected
+int bus_fd(void);
+// Poll events the connection waits for
+short bus_events(void);
+// Read and write on the connection, detecting a lost bus
+void bus_handle(void);
+// Check that a call is well formed without connecting, false with a message
+bool bus_check(const char *call);
+// Queue a call "<destination> <path> <interface>.<method> [<type>:<value> ...]",
+// types are string, int32, uint32, int64, uint64, double, boolean and objpath
+int bus_call(const char *call);
+// Close the connection and stop reconnecting
+void bus_disconnect(void);
+#endif
@@ -1,9 +1,13 @@
 #include "libinput-touchscreen.h"
 #include "calibration.h"
-#include "list.h"
+#include "realtime.h"
 
 #include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 movement read_screen_dimensions(const char *dimfile) {
 	FILE *dfile;
@@ -36,10 +40,10 @@ movement calibrate_touchscreen(const char *devpath, const char *dimfile) {
 	}
 	clear_event_pipe(li);
 
-	struct movement movements[10] = {{{0}}};
+	slots *touches = slots_new(MAX_SLOTS);
 	struct libinput_event *event;
 	struct pollfd fds;
-	list *ready;
+	slotmask ready;
 	fds.fd = libinput_get_fd(li);
 	fds.events = POLLIN;
 	fds.revents = 0;
@@ -51,39 +55,34 @@ movement calibrate_touchscreen(const char *devpath, const char *dimfile) {
 	while (poll(&fds, 1, -1) > -1) {
 		libinput_dispatch(li);
 		while ((event = libinput_get_event(li)) != NULL) {
-			// handle the event here
-			handle_event(event, movements);
+			handle_event(event, touches, 0);
 			libinput_event_destroy(event);
-			libinput_dispatch(li);
 		}
-		ready = get_ready_movements(movements);
-		if (ready == NULL) {
+		ready = get_ready_movements(touches);
+		if (ready == 0) {
 			continue;
 		}
-		if (list_len(ready) > 1) {
+		if (__builtin_popcountll(ready) > 1) {
 			printf("Please only use one finger\n");
 		} else {
-			node *cur = ready->head;
-			movement *m;
-			while (cur != NULL) {
-				m = movements + *((size_t *)cur->value);
+			movement m;
+			while (ready) {
+				m = slot_movement(touches, slotmask_pop(&ready));
 				switch(calibration_stage) {
 				case DIR_LEFT:
 				case DIR_RIGHT:
-					calibration_buffer[cal++] = m->start.x;
+					calibration_buffer[cal++] = m.start.x;
 					break;
 				case DIR_TOP:
 				case DIR_BOT:
-					calibration_buffer[cal++] = m->start.y;
+					calibration_buffer[cal++] = m.start.y;
 					break;
 				default:
 					break;
 				}
 				printf("Registered event\n");
-				cur = cur->next;
 			}
 		}
-		list_destroy(ready);
 		if (cal == CALIBRATION_NUM) {
 			switch(calibration_stage) {
 			case DIR_TOP:
@@ -126,7 +125,7 @@ movement calibrate_touchscreen(const char *devpath, const char *dimfile) {
 				printf("Finished calibrating. Saving to %s\n", dimfile);
 				calibration_stage = DIR_NONE;
 				break;
-			case DIR_NONE:
+			default:
 				break;
 			}
 			cal = 0;
@@ -135,14 +134,117 @@ movement calibrate_touchscreen(const char *devpath, const char *dimfile) {
 			break;
 		}
 	}
+	slots_destroy(touches);
 	logger("Screen: <%lf %lf> <%lf %lf>", screen.start.x, screen.end.x, screen.start.y, screen.end.y);
-	FILE *f = fopen(dimfile, "we");
-	if (f == NULL) {
-		printf("Error opening dim file\n");
-		return screen;
+	write_screen_dimensions(dimfile, &screen);
+	return screen;
+}
+
+bool write_screen_dimensions(const char *dimfile, const movement *screen) {
+	char tmppath[512];
+	FILE *f;
+	snprintf(tmppath, sizeof tmppath, "%s.tmp", dimfile);
+	if ((f = fopen(tmppath, "we")) == NULL) {
+		printf("Error opening dim file %s\n", tmppath);
+		return false;
 	}
-	fprintf(f, "%lf %lf  # X dimensions\n", screen.start.x, screen.end.x);
-	fprintf(f, "%lf %lf  # Y dimensions\n", screen.start.y, screen.end.y);
+	fprintf(f, "%lf %lf  # X dimensions\n", screen->start.x, screen->end.x);
+	fprintf(f, "%lf %lf  # Y dimensions\n", screen->start.y, screen->end.y);
 	fclose(f);
-	return screen;
+	// readers never see a partially written file
+	return rename(tmppath, dimfile) == 0;
+}
+
+typedef struct dims_job {
+	char *dimfile;
+	movement screen;
+} dims_job;
+
+static atomic_bool writing = false;
+
+static void *dims_worker(void *arg) {
+	dims_job *job = arg;
+	realtime_background();
+	write_screen_dimensions(job->dimfile, &job->screen);
+	free(job->dimfile);
+	free(job);
+	atomic_store(&writing, false);
+	return NULL;
+}
+
+bool write_screen_dimensions_async(const char *dimfile, const movement *screen) {
+	pthread_t thread;
+	dims_job *job;
+	bool idle = false;
+	if (!atomic_compare_exchange_strong(&writing, &idle, true)) {
+		return false;
+	}
+	job = malloc(sizeof *job);
+	job->dimfile = strdup(dimfile);
+	job->screen = *screen;
+	if (pthread_create(&thread, NULL, dims_worker, job) != 0) {
+		printf("Failed to start writing %s\n", dimfile);
+		free(job->dimfile);
+		free(job);
+		atomic_store(&writing, false);
+		return true;
+	}
+	pthread_detach(thread);
+	return true;
+}
+
+void edges_init(edge_estimator *e, double width, double height, movement *screen) {
+	float learned[4] = {screen->start.y, width - screen->end.x, height - screen->end.y, screen->start.x};
+	*e = (edge_estimator){.bounds = {.end = {width, height}}};
+	for (size_t edge = 0; edge < 4; edge++) {
+		// an edge not learned yet starts EDGE_ZONE inside the border, so that
+		// touches on the border already count as edge touches
+		if (learned[edge] <= 0) {
+			learned[edge] = EDGE_ZONE;
+		}
+		// a learned edge continues as if its extremes were all at the learned value
+		if (learned[edge] <= EDGE_ZONE) {
+			for (size_t i = 0; i < CALIBRATION_NUM; i++) {
+				e->near[edge][i] = learned[edge];
+			}
+			e->n[edge] = CALIBRATION_NUM;
+		}
+	}
+	screen->start = (vec2){learned[3], learned[0]};
+	screen->end = (vec2){width - learned[1], height - learned[2]};
+}
+
+bool edges_learn(edge_estimator *e, vec2 start, movement *screen) {
+	float w = e->bounds.end.x, h = e->bounds.end.y;
+	// distance to the top, right, bottom and left edge
+	float dist[4] = {start.y, w - start.x, h - start.y, start.x};
+	float *near, d;
+	movement old = *screen;
+	size_t i;
+	for (size_t edge = 0; edge < 4; edge++) {
+		d = dist[edge] > 0 ? dist[edge] : 0;
+		near = e->near[edge];
+		if (d > EDGE_ZONE || (e->n[edge] == CALIBRATION_NUM && d >= near[CALIBRATION_NUM - 1])) {
+			continue;
+		}
+		// insert sorted, dropping the farthest if full
+		i = e->n[edge] < CALIBRATION_NUM ? e->n[edge]++ : CALIBRATION_NUM - 1;
+		for (; i > 0 && near[i - 1] > d; i--) {
+			near[i] = near[i - 1];
+		}
+		near[i] = d;
+	}
+	if (e->n[0] == CALIBRATION_NUM) {
+		screen->start.y = e->near[0][CALIBRATION_NUM - 1];
+	}
+	if (e->n[1] == CALIBRATION_NUM) {
+		screen->end.x = w - e->near[1][CALIBRATION_NUM - 1];
+	}
+	if (e->n[2] == CALIBRATION_NUM) {
+		screen->end.y = h - e->near[2][CALIBRATION_NUM - 1];
+	}
+	if (e->n[3] == CALIBRATION_NUM) {
+		screen->start.x = e->near[3][CALIBRATION_NUM - 1];
+	}
+	return memcmp(&old, screen, sizeof old) != 0;
 }
@@ -1,8 +1,31 @@
 #ifndef CALIBRATION_H
 #define CALIBRATION_H
 #include "libinput-touchscreen.h"
+#include <stdbool.h>
 #define CALIBRATION_NUM 5  // number of required calibration attempts per side
+#define EDGE_ZONE 3.0  // touch downs closer than this in mm to an edge of the device teach the edge
+#define CALIBRATION_SAVE_INTERVAL 10000  // ms between background writes of learned calibrations
+
+// Touch downs closest to each edge of a device of known size. Per edge the
+// CALIBRATION_NUM closest ones are kept, in ascending distance, and the edge
+// reaches out to the farthest of them once that many were seen. Until then
+// the edge is EDGE_ZONE inside the border of the device.
+typedef struct edge_estimator {
+	movement bounds;  // device geometry
+	float near[4][CALIBRATION_NUM];  // distances to the top, right, bottom and left edge
+	size_t n[4];
+} edge_estimator;
 
 movement read_screen_dimensions(const char *dimfile);
+// Atomically replace dimfile with the calibration, false on errors
+bool write_screen_dimensions(const char *dimfile, const movement *screen);
+// Write the calibration on a background thread, false if a write still runs
+bool write_screen_dimensions_async(const char *dimfile, const movement *screen);
 movement calibrate_touchscreen(const char *devpath, const char *dimfile);
+
+// Start learning the edges of a width x height mm device from screen, moving
+// edges at the border of the device EDGE_ZONE inside
+void edges_init(edge_estimator *e, double width, double height, movement *screen);
+// Learn from a touch down position, true if screen changed
+bool edges_learn(edge_estimator *e, vec2 start, movement *screen);
 #endif
@@ -0,0 +1,103 @@
+#include "capture.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int capfd = -1;
+static touch_record capbuf[CAPTURE_BUFSIZE];
+static size_t caplen = 0;
+
+bool capture_start(const char *path) {
+	capture_header h = {.magic = CAPTURE_MAGIC, .version = CAPTURE_VERSION, .recsize = sizeof(touch_record)};
+	capfd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (capfd == -1) {
+		printf("Failed to open capture %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	if (write(capfd, &h, sizeof h) != sizeof h) {
+		printf("Failed to write capture header: %s\n", strerror(errno));
+		close(capfd);
+		capfd = -1;
+		return false;
+	}
+	printf("Recording touch events to %s\n", path);
+	return true;
+}
+
+void capture_write(const touch_record *t) {
+	if (capfd == -1) {
+		return;
+	}
+	capbuf[caplen++] = *t;
+	if (caplen == CAPTURE_BUFSIZE) {
+		capture_flush();
+	}
+}
+
+void capture_flush(void) {
+	ssize_t size = caplen * sizeof *capbuf;
+	if (capfd == -1 || caplen == 0) {
+		return;
+	}
+	if (write(capfd, capbuf, size) != size) {
+		printf("Failed to write capture, stop recording: %s\n", strerror(errno));
+		close(capfd);
+		capfd = -1;
+	}
+	caplen = 0;
+}
+
+void capture_stop(void) {
+	if (capfd == -1) {
+		return;
+	}
+	capture_flush();
+	close(capfd);
+	capfd = -1;
+}
+
+capture *capture_open(const char *path) {
+	struct stat st;
+	const capture_header *h;
+	capture *c;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		printf("Failed to open capture %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof *h) {
+		printf("Invalid capture %s\n", path);
+		close(fd);
+		return NULL;
+	}
+	c = calloc(1, sizeof *c);
+	c->mapsize = st.st_size;
+	c->map = mmap(NULL, c->mapsize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (c->map == MAP_FAILED) {
+		printf("Failed to map capture %s: %s\n", path, strerror(errno));
+		free(c);
+		return NULL;
+	}
+	h = c->map;
+	if (memcmp(h->magic, CAPTURE_MAGIC, sizeof h->magic) != 0 ||
+	    h->version != CAPTURE_VERSION || h->recsize != sizeof(touch_record)) {
+		printf("Unsupported capture format in %s\n", path);
+		capture_close(c);
+		return NULL;
+	}
+	c->records = (const touch_record *)(h + 1);
+	c->len = (c->mapsize - sizeof *h) / sizeof(touch_record);
+	return c;
+}
+
+void capture_close(capture *c) {
+	munmap(c->map, c->mapsize);
+	free(c);
+}
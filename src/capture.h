@@ -0,0 +1,39 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include "libinput-touchscreen.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#define CAPTURE_MAGIC "LITSCAP"  // file magic including terminating zero
+#define CAPTURE_VERSION 1
+#define CAPTURE_BUFSIZE 256  // number of records buffered before writing
+
+// Capture files are a header followed by a flat array of touch records in
+// host byte order, so they can be mapped and iterated directly.
+typedef struct capture_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t recsize;  // size of a single touch record
+} capture_header;
+
+typedef struct capture {
+	const touch_record *records;
+	size_t len;  // number of records
+	void *map;
+	size_t mapsize;
+} capture;
+
+// Start recording all touch events into path
+bool capture_start(const char *path);
+// Buffer a touch record, does nothing if not recording
+void capture_write(const touch_record *t);
+// Write out buffered records
+void capture_flush(void);
+// Flush and close the capture file
+void capture_stop(void);
+
+// Map a capture file for reading, NULL on error
+capture *capture_open(const char *path);
+// Unmap capture file
+void capture_close(capture *c);
+#endif
@@ -1,5 +1,10 @@
 #include "libinput-touchscreen.h"
 #include "configuration.h"
+#include "action.h"
+#include "ruleset.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -29,19 +34,287 @@ bool str_startswith(const char *line, char c) {
 	return false;
 }
 
-gesture *str_to_gesture(char *line) {
-	gesture *g = calloc(1, sizeof *g);
-	char *next = strtok(line, " ");
-	g->type = str_to_gesttype(next);
-	next = strtok(NULL, " ");
-	g->dir = str_to_direction(next);
-	next = strtok(NULL, " ");
-	g->num = atoi(next);
-	if (g->type == GT_NONE) {
-		free(g);
-		return NULL;
+// parse a whole word as integer between min and max
+bool str_to_long(const char *s, long min, long max, long *out) {
+	char *end;
+	long v = strtol(s, &end, 10);
+	if (end == s || *end != '\0' || v < min || v > max) {
+		return false;
+	}
+	*out = v;
+	return true;
+}
+
+// parse a whole word as finite number between min and max
+bool str_to_double(const char *s, double min, double max, double *out) {
+	char *end;
+	double v = strtod(s, &end);
+	if (end == s || *end != '\0' || !isfinite(v) || v < min || v > max) {
+		return false;
+	}
+	*out = v;
+	return true;
+}
+
+// parse finger count or range like 3-5, * matches all counts
+bool str_to_num(const char *s, rule *r) {
+	const char *dash;
+	char *end;
+	long min, max;
+	bool valid;
+	if (strcmp(s, "*") == 0) {
+		r->key.num = 1;
+		r->maxnum = RULE_MAX_FINGERS;
+		return true;
+	}
+	min = max = strtol(s, &end, 10);
+	valid = end != s;
+	if (valid && *end == '-') {
+		dash = end;
+		max = strtol(dash + 1, &end, 10);
+		valid = end != dash + 1;
+	}
+	// the whole word has to be the count or range
+	if (!valid || *end != '\0' || min < 0 || max < min || max > RULE_MAX_FINGERS) {
+		printf("Invalid finger count %s\n", s);
+		return false;
+	}
+	r->key.num = min;
+	r->maxnum = max;
+	return true;
+}
+
+// find a declared template by name
+const shape *find_template(const shape_template *templates, size_t n, const char *name) {
+	for (size_t i = 0; i < n; i++) {
+		if (strcmp(templates[i].name, name) == 0) {
+			return &templates[i].s;
+		}
+	}
+	printf("Unknown template %s\n", name);
+	return NULL;
+}
+
+// parse rule key <TYPE> <DIRECTION|TEMPLATE> <NUM_FINGER> into rule
+bool str_to_key(char *line, rule *r, const shape_template *templates, size_t ntemplates, char **save) {
+	const shape *tmpl;
+	char *next = strtok_r(line, " \t\n", save);
+	r->key.type = str_to_gesttype(next);
+	if (r->key.type == GT_NONE) {
+		return false;
+	}
+	if ((next = strtok_r(NULL, " \t\n", save)) == NULL) {
+		return false;
+	}
+	if (r->key.type == GT_SHAPE) {
+		if ((tmpl = find_template(templates, ntemplates, next)) == NULL) {
+			return false;
+		}
+		r->tmpl = *tmpl;
+	}
+	r->anydir = strcmp(next, "*") == 0;
+	r->key.dir = str_to_direction(next);
+	if ((next = strtok_r(NULL, " \t\n", save)) == NULL) {
+		return false;
+	}
+	return str_to_num(next, r);
+}
+
+// find a declared zone by name
+const zone *find_zone(const named_zone *zones, size_t n, const char *name) {
+	for (size_t i = 0; i < n; i++) {
+		if (strcmp(zones[i].name, name) == 0) {
+			return &zones[i].z;
+		}
+	}
+	printf("Unknown zone %s\n", name);
+	return NULL;
+}
+
+// parse trailing key=value options of a rule line, continuing after str_to_key
+bool str_to_options(rule *r, const named_zone *zones, size_t nzones, char **save) {
+	const zone *z;
+	char *next, *value;
+	double d;
+	long l;
+	while ((next = strtok_r(NULL, " \t\n", save)) != NULL) {
+		if ((value = strchr(next, '=')) == NULL) {
+			printf("Invalid rule option %s\n", next);
+			return false;
+		}
+		*value++ = '\0';
+		if (strcmp(next, "timeout") == 0) {
+			if (!str_to_double(value, 0, UINT32_MAX / 1000, &d)) {
+				printf("Invalid timeout %s\n", value);
+				return false;
+			}
+			r->timeout = d * 1000;
+		} else if (strcmp(next, "priority") == 0) {
+			if (!str_to_long(value, INT_MIN, INT_MAX, &l)) {
+				printf("Invalid priority %s\n", value);
+				return false;
+			}
+			r->priority = l;
+		} else if (strcmp(next, "early") == 0) {
+			if (!str_to_double(value, 0, FLT_MAX, &d)) {
+				printf("Invalid early distance %s\n", value);
+				return false;
+			}
+			r->early = d;
+		} else if (strcmp(next, "rate") == 0) {
+			if (!str_to_double(value, 0, FLT_MAX, &d)) {
+				printf("Invalid rate %s\n", value);
+				return false;
+			}
+			r->rate = d;
+		} else if (strcmp(next, "zone") == 0) {
+			// shapes and continuous gestures have no single start
+			if (r->key.type == GT_SHAPE || r->key.type == GT_PINCH || r->key.type == GT_ROTATE) {
+				printf("Zones only apply to TAP, MOVEMENT, BORDER, HOLD and LONGPRESS\n");
+				return false;
+			}
+			if ((z = find_zone(zones, nzones, value)) == NULL) {
+				return false;
+			}
+			r->area = *z;
+			r->zoned = true;
+		} else {
+			printf("Unknown rule option %s\n", next);
+			return false;
+		}
+	}
+	return true;
+}
+
+// parse a SET <name> <value> line into settings, valid is cleared on errors
+bool str_to_setting(char *line, settings *s, bool *valid) {
+	char *name, *value, *save;
+	double d;
+	long l;
+	if (strcmp(strtok_r(line, " \t\n", &save), "SET") != 0) {
+		return false;
+	}
+	if ((name = strtok_r(NULL, " \t\n", &save)) == NULL || (value = strtok_r(NULL, " \t\n", &save)) == NULL) {
+		printf("Incomplete SET line\n");
+		*valid = false;
+		return true;
+	}
+	if (strcmp(name, "max_children") == 0) {
+		if ((*valid = str_to_long(value, 0, LONG_MAX, &l))) {
+			s->max_children = l;
+		}
+	} else if (strcmp(name, "timeout") == 0) {
+		if ((*valid = str_to_double(value, 0, UINT32_MAX / 1000, &d))) {
+			s->timeout = d * 1000;
+		}
+	} else if (strcmp(name, "directions") == 0) {
+		if (!(*valid = str_to_long(value, 4, 8, &l) && (l == 4 || l == 8))) {
+			printf("Directions must be 4 or 8\n");
+			return true;
+		}
+		s->directions = l;
+	} else if (strcmp(name, "hold") == 0) {
+		if ((*valid = str_to_double(value, 0, UINT32_MAX / 1000, &d))) {
+			s->hold = d * 1000;
+		}
+	} else if (strcmp(name, "deadzone") == 0) {
+		*valid = str_to_double(value, 0, HUGE_VAL, &s->deadzone);
+	} else if (strcmp(name, "edge") == 0) {
+		*valid = str_to_double(value, 0, HUGE_VAL, &s->edge);
+	} else {
+		printf("Unknown setting %s\n", name);
+		*valid = false;
+		return true;
+	}
+	if (!*valid) {
+		printf("Invalid value %s of setting %s\n", value, name);
 	}
-	return g;
+	return true;
+}
+
+// parse a TEMPLATE <name> <x>,<y> <x>,<y> ... line, valid is cleared on errors
+bool str_to_template(char *line, shape_template *templates, size_t *n, bool *valid) {
+	float x[BUFSIZE / 4], y[BUFSIZE / 4];
+	size_t npoints = 0;
+	char *name, *next, *end, *save;
+	if (strcmp(strtok_r(line, " \t\n", &save), "TEMPLATE") != 0) {
+		return false;
+	}
+	if ((name = strtok_r(NULL, " \t\n", &save)) == NULL || *n == SHAPE_MAX_TEMPLATES) {
+		printf("Missing template name or more than %d templates\n", SHAPE_MAX_TEMPLATES);
+		*valid = false;
+		return true;
+	}
+	while (npoints < BUFSIZE / 4 && (next = strtok_r(NULL, " \t\n", &save)) != NULL) {
+		x[npoints] = strtof(next, &end);
+		if (*end != ',') {
+			printf("Invalid template point %s\n", next);
+			*valid = false;
+			return true;
+		}
+		y[npoints++] = strtof(end + 1, NULL);
+	}
+	if (!shape_from_path(x, y, npoints, &templates[*n].s)) {
+		printf("Template %s needs at least two distinct points\n", name);
+		*valid = false;
+		return true;
+	}
+	snprintf(templates[*n].name, sizeof templates[*n].name, "%s", name);
+	(*n)++;
+	return true;
+}
+
+// parse a ZONE <name> <x0> <y0> <x1> <y1> line in percent of the screen,
+// valid is cleared on errors
+bool str_to_zone(char *line, named_zone *zones, size_t *n, bool *valid) {
+	float v[4];
+	char *name, *next, *end, *save;
+	if (strcmp(strtok_r(line, " \t\n", &save), "ZONE") != 0) {
+		return false;
+	}
+	if ((name = strtok_r(NULL, " \t\n", &save)) == NULL || *n == ZONE_MAX) {
+		printf("Missing zone name or more than %d zones\n", ZONE_MAX);
+		*valid = false;
+		return true;
+	}
+	for (size_t i = 0; i < 4; i++) {
+		if ((next = strtok_r(NULL, " \t\n", &save)) == NULL || (v[i] = strtof(next, &end)) < 0 || v[i] > 100 ||
+		    *end != '\0') {
+			printf("Zone %s needs x0 y0 x1 y1 between 0 and 100\n", name);
+			*valid = false;
+			return true;
+		}
+	}
+	if (v[2] <= v[0] || v[3] <= v[1]) {
+		printf("Zone %s is empty\n", name);
+		*valid = false;
+		return true;
+	}
+	zones[*n].z = (zone){v[0] / 100, v[1] / 100, v[2] / 100, v[3] / 100};
+	snprintf(zones[*n].name, sizeof zones[*n].name, "%s", name);
+	(*n)++;
+	return true;
+}
+
+// parse a [<app>] section header, [*] returns to global rules
+bool str_to_section(const char *line, char *app, size_t size) {
+	const char *start = line, *end;
+	while (whitespace(*start)) {
+		start++;
+	}
+	if (*start != '[' || (end = strchr(start, ']')) == NULL) {
+		return false;
+	}
+	start++;
+	if (end - start == 1 && *start == '*') {
+		end = start;
+	}
+	if ((size_t)(end - start) >= size) {
+		end = start + size - 1;
+	}
+	memcpy(app, start, end - start);
+	app[end - start] = '\0';
+	return true;
 }
 
 char *str_to_command(const char *line) {
@@ -64,20 +337,32 @@ bool blank_line(const char *line) {
 	return true;
 }
 
-// load a config file containing rules
-list *load_rules(const char *path) {
-	rule *currule = calloc(1, sizeof *currule);
-	gesture *g;
-	char *c;
-	list *l = NULL;
+// load a config file containing rules, NULL if it has errors and an empty
+// list if it has no rules
+list *load_rules(const char *path, settings *s) {
+	rule *currule;
+	char *c, *save;
+	list *l;
 	char buffer[BUFSIZE];
 	FILE *f = fopen(path, "re");
 	if (f == NULL) {
 		printf("Failed to open config at %s\n", path);
-		return l;
+		return NULL;
 	}
+	currule = calloc(1, sizeof *currule);
+	l = calloc(1, sizeof *l);
 	int state = 0;
+	char setbuf[BUFSIZE];
+	size_t lineno = 0, errors = 0;
+	char app[sizeof currule->app] = "";
+	shape_template templates[SHAPE_MAX_TEMPLATES];
+	size_t ntemplates = 0;
+	named_zone zones[ZONE_MAX];
+	size_t nzones = 0;
+	bool valid;
 	while (fgets(buffer, BUFSIZE, f) != NULL) {
+		lineno++;
+		valid = true;
 		if (str_startswith(buffer, '#')) {
 			continue;
 		}
@@ -86,27 +371,86 @@ list *load_rules(const char *path) {
 		}
 		switch(state) {
 		case 0:
-			if ((g = str_to_gesture(buffer)) != NULL) {
-				currule->key = *g;
-				free(g);
+			memcpy(setbuf, buffer, BUFSIZE);
+			if (str_to_setting(setbuf, s, &valid)) {
+				break;
+			}
+			memcpy(setbuf, buffer, BUFSIZE);
+			if (str_to_template(setbuf, templates, &ntemplates, &valid)) {
+				break;
+			}
+			memcpy(setbuf, buffer, BUFSIZE);
+			if (str_to_zone(setbuf, zones, &nzones, &valid)) {
+				break;
+			}
+			if (str_to_section(buffer, app, sizeof app)) {
+				break;
+			}
+			if (str_to_key(buffer, currule, templates, ntemplates, &save) &&
+			    str_to_options(currule, zones, nzones, &save)) {
+				memcpy(currule->app, app, sizeof app);
 				state = 1;
+			} else {
+				memset(currule, 0, sizeof *currule);
+				valid = false;
 			}
 			break;
 		case 1:
-			c = str_to_command(buffer);
-			strncpy(currule->command, c, 512);
+			if ((c = str_to_command(buffer)) == NULL) {
+				valid = false;
+				break;
+			}
+			// rejected here, so that a reload keeps the previous rules
+			if (!action_check(c)) {
+				free(c);
+				memset(currule, 0, sizeof *currule);
+				state = 0;
+				valid = false;
+				break;
+			}
+			strncpy(currule->command, c, 511);
 			free(c);
 			state = 0;
-			if (l == NULL) {
-				l = list_new(currule, sizeof *currule);
-			} else {
-				list_append(l, currule, sizeof *currule);
-			}
+			list_append(l, currule, sizeof *currule);
 			currule = calloc(1, sizeof *currule);
 			break;
 		default:
 			break;
 		}
+		if (!valid) {
+			printf("%s:%lu: invalid line\n", path, lineno);
+			errors++;
+		}
+	}
+	free(currule);
+	fclose(f);
+	if (state == 1) {
+		printf("%s: missing command of last rule\n", path);
+		errors++;
+	}
+	if (errors > 0) {
+		list_destroy(l);
+		return NULL;
+	}
+	// rules without explicit timeout use the global default
+	for (node *cur = l->head; cur != NULL; cur = cur->next) {
+		currule = (rule *)cur->value;
+		if (currule->timeout == 0) {
+			currule->timeout = s->timeout;
+		}
 	}
 	return l;
 }
+
+char *get_conf_path(const char *filename) {
+	const char *config_frag = "/.config/";
+	char *homedir = getenv("HOME");
+	size_t lconfdir = strlen(homedir) + strlen(config_frag) + strlen(PROGNAME) + 1 + strlen(filename) + 1;
+	char *confdir = calloc(lconfdir, sizeof *confdir);
+	memcpy(confdir, homedir, strlen(homedir));
+	strncat(confdir, config_frag, lconfdir);
+	strncat(confdir, PROGNAME, lconfdir);
+	strncat(confdir, "/", lconfdir);
+	strncat(confdir, filename, lconfdir);
+	return confdir;
+}
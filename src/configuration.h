@@ -1,9 +1,37 @@
 #ifndef CONFIGURATION_H
 #define CONFIGURATION_H
 #include "list.h"
+#include "shape.h"
+#include "zone.h"
+#include <stddef.h>
+#include <stdint.h>
 
+#define PROGNAME "libinput-touchscreen"
 // size of read buffer
 #define BUFSIZE 512
 
-list *load_rules(const char *path);
+// named stroke template declared by a TEMPLATE line
+typedef struct shape_template {
+	char name[32];
+	shape s;
+} shape_template;
+
+// named screen region declared by a ZONE line
+typedef struct named_zone {
+	char name[32];
+	zone z;
+} named_zone;
+
+typedef struct settings {
+	size_t max_children;  // maximum number of concurrently running commands
+	uint32_t timeout;  // default command timeout in ms, 0 for none
+	int directions;  // number of movement directions told apart, 4 or 8
+	double deadzone;  // movements up to this length in mm have no direction
+	uint32_t hold;  // time in ms fingers rest before hold gestures fire
+	double edge;  // shortest border gesture in mm, 0 for the default
+} settings;
+
+list *load_rules(const char *path, settings *s);
+// Path of a file in the user configuration directory
+char *get_conf_path(const char *filename);
 #endif
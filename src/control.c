@@ -0,0 +1,320 @@
+#include "control.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef struct client {
+	int fd;  // -1 if unused
+	char in[CONTROL_LINE];
+	size_t inlen;
+	char out[CONTROL_OUTSIZE];
+	size_t outlen;
+	size_t listed;  // next rule of a running listing, SIZE_MAX if none
+	unsigned long listgen;  // rules generation the listing started on
+	bool overflow;  // a reply did not fit, disconnect
+	bool eof;  // client is done sending, close once replies are out
+} client;
+
+static int listenfd = -1;
+static char *socketpath = NULL;
+static client clients[CONTROL_CLIENTS];
+static touch_device *virtual = NULL;  // touchscreen of injected touches
+static unsigned long generation = 0;  // bumped whenever the rules are replaced
+
+bool control_init(const char *path) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	mode_t mask;
+	if (strlen(path) >= sizeof addr.sun_path) {
+		printf("Control socket path too long: %s\n", path);
+		return false;
+	}
+	strcpy(addr.sun_path, path);
+	listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	// a socket left over from a previous run
+	unlink(path);
+	// only the user may control the daemon
+	mask = umask(0077);
+	if (listenfd == -1 || bind(listenfd, (struct sockaddr *)&addr, sizeof addr) == -1 ||
+	    listen(listenfd, CONTROL_CLIENTS) == -1) {
+		printf("Failed to listen on %s: %s\n", path, strerror(errno));
+		umask(mask);
+		close(listenfd);
+		listenfd = -1;
+		return false;
+	}
+	umask(mask);
+	socketpath = strdup(path);
+	for (size_t i = 0; i < CONTROL_CLIENTS; i++) {
+		clients[i].fd = -1;
+	}
+	return true;
+}
+
+void control_pollfds(struct pollfd *fds) {
+	client *c;
+	fds[0] = (struct pollfd){.fd = listenfd, .events = POLLIN};
+	for (size_t i = 0; i < CONTROL_CLIENTS; i++) {
+		c = clients + i;
+		fds[i + 1] = (struct pollfd){.fd = c->fd};
+		// replies have to drain before more commands are read
+		if (!c->eof && c->listed == SIZE_MAX && c->outlen < CONTROL_OUTSIZE / 2) {
+			fds[i + 1].events |= POLLIN;
+		}
+		if (c->outlen > 0) {
+			fds[i + 1].events |= POLLOUT;
+		}
+	}
+}
+
+static void client_close(client *c) {
+	close(c->fd);
+	c->fd = -1;
+	c->inlen = c->outlen = 0;
+	c->listed = SIZE_MAX;
+	c->overflow = c->eof = false;
+}
+
+static void reply(client *c, const char *format, ...) {
+	va_list args;
+	int len;
+	if (c->overflow) {
+		return;
+	}
+	va_start(args, format);
+	len = vsnprintf(c->out + c->outlen, CONTROL_OUTSIZE - c->outlen, format, args);
+	va_end(args);
+	if (len < 0 || (size_t)len >= CONTROL_OUTSIZE - c->outlen) {
+		c->overflow = true;
+		return;
+	}
+	c->outlen += len;
+}
+
+static void accept_clients(void) {
+	size_t i;
+	int fd;
+	while ((fd = accept(listenfd, NULL, NULL)) != -1) {
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		for (i = 0; i < CONTROL_CLIENTS && clients[i].fd != -1; i++);
+		if (i == CONTROL_CLIENTS) {
+			printf("Too many control clients\n");
+			close(fd);
+			continue;
+		}
+		clients[i].fd = fd;
+		clients[i].listed = SIZE_MAX;
+	}
+}
+
+// continue a listing with the rules that fit, the rest follows as the
+// client reads
+static void list_rules(client *c, const ruleset *rules) {
+	// room for the longest line: command, index, state and hits
+	size_t line = sizeof rules->rules->command + 64;
+	// indexes of the replaced rules mean nothing in the new ones
+	if (c->listgen != generation) {
+		c->listed = SIZE_MAX;
+		reply(c, "error rules reloaded\n");
+		return;
+	}
+	for (; c->listed < rules->len; c->listed++) {
+		if (CONTROL_OUTSIZE - c->outlen < line) {
+			return;
+		}
+		reply(c, "%zu %s %" PRIu64 " %s\n", c->listed, rules->disabled[c->listed] ? "off" : "on",
+		      rules->hits[c->listed], rules->rules[c->listed].command);
+	}
+	c->listed = SIZE_MAX;
+	reply(c, "ok\n");
+}
+
+static void show_stats(client *c) {
+	char buffer[2048] = "";
+	FILE *f = fmemopen(buffer, sizeof buffer, "w");
+	if (f == NULL) {
+		reply(c, "error %s\n", strerror(errno));
+		return;
+	}
+	trace_dump(f);
+	fclose(f);
+	reply(c, "%sok\n", buffer);
+}
+
+static void inject(client *c, char *args, ruleset *rules, frame_handler frame) {
+	static const char *types[] = {"down", "up", "motion", "cancel", "frame"};
+	touch_record t = {.time = trace_now()};
+	char *save, *type = strtok_r(args, " \t", &save);
+	char *slot = strtok_r(NULL, " \t", &save), *x = strtok_r(NULL, " \t", &save);
+	char *y = strtok_r(NULL, " \t", &save);
+	size_t i;
+	for (i = 0; type != NULL && i < sizeof types / sizeof *types && strcmp(type, types[i]) != 0; i++);
+	if (type == NULL || i == sizeof types / sizeof *types) {
+		reply(c, "error unknown touch type\n");
+		return;
+	}
+	t.type = i;
+	if (t.type != TT_FRAME && slot == NULL) {
+		reply(c, "error missing slot\n");
+		return;
+	}
+	if ((t.type == TT_DOWN || t.type == TT_MOTION) && y == NULL) {
+		reply(c, "error missing position\n");
+		return;
+	}
+	if (virtual == NULL && (virtual = device_attach("control", NULL, 0, 0, 0, 0, MAX_SLOTS)) == NULL) {
+		reply(c, "error no touchscreen left\n");
+		return;
+	}
+	t.device = virtual->index;
+	t.slot = slot ? atoi(slot) : 0;
+	t.x = x ? strtof(x, NULL) : 0;
+	t.y = y ? strtof(y, NULL) : 0;
+	device_record(virtual, &t);
+	if (t.type == TT_FRAME) {
+		frame(virtual, rules);
+	}
+}
+
+static void run_command(client *c, char *line, ruleset *rules, frame_handler frame) {
+	char *save, *cmd = strtok_r(line, " \t", &save), *args = strtok_r(NULL, "", &save);
+	char *end;
+	size_t index;
+	if (cmd == NULL) {
+		return;
+	}
+	if (strcmp(cmd, "touch") == 0) {
+		inject(c, args ? args : "", rules, frame);
+	} else if (strcmp(cmd, "rules") == 0) {
+		c->listed = 0;
+		c->listgen = generation;
+		list_rules(c, rules);
+	} else if (strcmp(cmd, "stats") == 0) {
+		show_stats(c);
+	} else if (strcmp(cmd, "enable") == 0 || strcmp(cmd, "disable") == 0) {
+		index = args ? strtoul(args, &end, 10) : 0;
+		if (args == NULL || end == args || !ruleset_enable(rules, index, cmd[0] == 'e')) {
+			reply(c, "error no such rule\n");
+		} else {
+			reply(c, "ok\n");
+		}
+	} else {
+		reply(c, "error unknown command %s\n", cmd);
+	}
+}
+
+// run complete lines in the input buffer, stopping behind one that starts a
+// listing, false if the client sent an overlong line
+static bool client_run(client *c, ruleset *rules, frame_handler frame) {
+	char *line = c->in, *newline;
+	while (c->listed == SIZE_MAX && (newline = memchr(line, '\n', c->in + c->inlen - line)) != NULL) {
+		*newline = '\0';
+		run_command(c, line, rules, frame);
+		line = newline + 1;
+	}
+	c->inlen -= line - c->in;
+	memmove(c->in, line, c->inlen);
+	if (c->inlen == sizeof c->in && memchr(c->in, '\n', c->inlen) == NULL) {
+		printf("Control command too long\n");
+		return false;
+	}
+	return true;
+}
+
+// read and run commands, false if the client is gone
+static bool client_read(client *c, ruleset *rules, frame_handler frame) {
+	ssize_t n = read(c->fd, c->in + c->inlen, sizeof c->in - c->inlen);
+	if (n == -1 && errno != EAGAIN) {
+		return false;
+	}
+	c->eof = n == 0;
+	if (n > 0) {
+		c->inlen += n;
+	}
+	return client_run(c, rules, frame);
+}
+
+static bool client_write(client *c) {
+	ssize_t n = send(c->fd, c->out, c->outlen, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (n == -1) {
+		return errno == EAGAIN;
+	}
+	c->outlen -= n;
+	memmove(c->out, c->out + n, c->outlen);
+	return true;
+}
+
+void control_handle(const struct pollfd *fds, ruleset *rules, frame_handler frame) {
+	client *c;
+	bool alive;
+	if (listenfd == -1) {
+		return;
+	}
+	if (fds[0].revents & POLLIN) {
+		accept_clients();
+	}
+	for (size_t i = 0; i < CONTROL_CLIENTS; i++) {
+		c = clients + i;
+		if (c->fd == -1 || fds[i + 1].fd != c->fd || fds[i + 1].revents == 0) {
+			continue;
+		}
+		alive = !(fds[i + 1].revents & (POLLERR | POLLNVAL));
+		// commands behind a listing wait in the input buffer
+		if (alive && c->listed == SIZE_MAX && (fds[i + 1].revents & (POLLIN | POLLHUP))) {
+			alive = client_read(c, rules, frame);
+		}
+		if (c->overflow) {
+			printf("Control client does not read its replies\n");
+			alive = false;
+		}
+		// replies go out right away, the socket usually has room
+		if (alive && c->outlen > 0) {
+			alive = client_write(c);
+		}
+		// fill the room the write made, then run the commands held back
+		if (alive && c->listed != SIZE_MAX) {
+			list_rules(c, rules);
+			alive = c->listed != SIZE_MAX || client_run(c, rules, frame);
+		}
+		if (c->eof && c->outlen == 0 && c->listed == SIZE_MAX) {
+			alive = false;
+		}
+		if (!alive) {
+			client_close(c);
+		}
+	}
+}
+
+void control_rules_changed(void) {
+	generation++;
+}
+
+void control_destroy(void) {
+	if (listenfd == -1) {
+		return;
+	}
+	for (size_t i = 0; i < CONTROL_CLIENTS; i++) {
+		if (clients[i].fd != -1) {
+			client_close(clients + i);
+		}
+	}
+	if (virtual != NULL) {
+		device_detach(virtual);
+		virtual = NULL;
+	}
+	close(listenfd);
+	listenfd = -1;
+	unlink(socketpath);
+	free(socketpath);
+}
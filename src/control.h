@@ -0,0 +1,36 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+#include "backend.h"
+#include "ruleset.h"
+#include <poll.h>
+#define CONTROL_CLIENTS 4  // most connected clients, more are turned away
+#define CONTROL_FDS (CONTROL_CLIENTS + 1)  // pollfds used, listening socket first
+#define CONTROL_LINE 512  // longest command line
+#define CONTROL_OUTSIZE 65536  // reply bytes buffered per client
+
+// Line based control socket served from the poll loop. Commands:
+//   rules                       list rules as <index> <on|off> <hits> <command>
+//   enable <index>              put a rule back into the tables
+//   disable <index>             leave a rule out of the tables
+//   stats                       latency and wakeup stats
+//   touch <down|motion|up|cancel|frame> [<slot> <x> <y>]
+//                               feed a touch of a virtual touchscreen, in mm
+// Every command except touch is answered with "ok" or "error <reason>" as
+// the last line, touch only answers errors. Sockets never block: commands
+// are only read while a client has room for replies, a rule listing is
+// written in pieces as the client reads it and ends with an error if the
+// rules are reloaded meanwhile, and clients sending overlong lines or
+// overflowing their reply buffer are disconnected.
+
+// Listen on the unix socket at path, false on errors
+bool control_init(const char *path);
+// Fill CONTROL_FDS pollfds for the listening socket and clients
+void control_pollfds(struct pollfd *fds);
+// Accept clients, run their commands and write replies, injected frames are
+// passed to frame with the rules
+void control_handle(const struct pollfd *fds, ruleset *rules, frame_handler frame);
+// The rules were replaced, running listings end with an error
+void control_rules_changed(void);
+// Disconnect all clients and remove the socket
+void control_destroy(void);
+#endif
@@ -0,0 +1,327 @@
+#include "evdev-backend.h"
+#include "backend.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+void evdev_parser_init(evdev_parser *p, evdev_axis x, evdev_axis y, int fd, uint8_t device) {
+	*p = (evdev_parser){.x = x, .y = y, .fd = fd, .device = device};
+	// axes without resolution are taken as mm, like libinput does
+	p->x.res = p->x.res > 0 ? p->x.res : 1;
+	p->y.res = p->y.res > 0 ? p->y.res : 1;
+	for (size_t i = 0; i < MAX_SLOTS; i++) {
+		p->ids[i] = -1;
+	}
+}
+
+static void set_id(evdev_parser *p, size_t slot, int32_t id) {
+	slotmask bit = (slotmask)1 << slot;
+	if (id == p->ids[slot]) {
+		return;
+	}
+	// a new id without lift replaces the touch
+	if (p->ids[slot] >= 0) {
+		p->ended |= bit;
+	}
+	if (id >= 0) {
+		p->began |= bit;
+	}
+	p->ids[slot] = id;
+}
+
+static void set_position(evdev_parser *p, size_t slot, bool y, int32_t value) {
+	if (y) {
+		p->posy[slot] = (float)(value - p->y.min) / p->y.res;
+	} else {
+		p->posx[slot] = (float)(value - p->x.min) / p->x.res;
+	}
+	p->moved |= (slotmask)1 << slot;
+}
+
+// report changes of all slots in the order of libinput, then a frame
+static size_t flush(evdev_parser *p, uint64_t time, record_handler handle, void *data) {
+	slotmask changed = p->began | p->ended | p->moved, bit;
+	touch_record t = {.time = time, .device = p->device};
+	size_t n = 0, i;
+	bool active;
+	while (changed) {
+		i = slotmask_pop(&changed);
+		bit = (slotmask)1 << i;
+		active = p->ids[i] >= 0;
+		t.slot = i;
+		if ((p->ended & bit) && active) {
+			t.type = TT_UP;
+			t.x = t.y = 0;
+			handle(&t, data);
+			n++;
+		}
+		t.x = p->posx[i];
+		t.y = p->posy[i];
+		if ((p->began & bit) || ((p->moved & bit) && active)) {
+			t.type = p->began & bit ? TT_DOWN : TT_MOTION;
+			handle(&t, data);
+			n++;
+		}
+		if ((p->ended & bit) && !active) {
+			t.type = TT_UP;
+			t.x = t.y = 0;
+			handle(&t, data);
+			n++;
+		}
+	}
+	p->began = p->ended = p->moved = 0;
+	if (n > 0) {
+		handle(&(touch_record){.time = time, .type = TT_FRAME, .device = p->device}, data);
+		n++;
+	}
+	return n;
+}
+
+size_t evdev_parser_sync(evdev_parser *p, uint64_t time, record_handler handle, void *data) {
+	struct input_absinfo slot;
+	int32_t values[MAX_SLOTS + 1];
+	if (p->fd < 0) {
+		return flush(p, time, handle, data);
+	}
+	// slots beyond the device are left untouched by the kernel
+	memset(values, 0xff, sizeof values);
+	values[0] = ABS_MT_TRACKING_ID;
+	if (ioctl(p->fd, EVIOCGMTSLOTS(sizeof values), values) == -1) {
+		return flush(p, time, handle, data);
+	}
+	for (size_t i = 0; i < MAX_SLOTS; i++) {
+		set_id(p, i, values[i + 1]);
+	}
+	for (int axis = ABS_MT_POSITION_X; axis <= ABS_MT_POSITION_Y; axis++) {
+		values[0] = axis;
+		ioctl(p->fd, EVIOCGMTSLOTS(sizeof values), values);
+		for (size_t i = 0; i < MAX_SLOTS; i++) {
+			if (p->ids[i] >= 0) {
+				set_position(p, i, axis == ABS_MT_POSITION_Y, values[i + 1]);
+			}
+		}
+	}
+	if (ioctl(p->fd, EVIOCGABS(ABS_MT_SLOT), &slot) == 0) {
+		p->slot = slot.value < MAX_SLOTS ? slot.value : -1;
+	}
+	return flush(p, time, handle, data);
+}
+
+size_t evdev_parse(evdev_parser *p, const struct input_event *ev, size_t n, record_handler handle, void *data) {
+	size_t records = 0;
+	uint64_t time;
+	for (size_t i = 0; i < n; i++) {
+		time = (uint64_t)ev[i].input_event_sec * 1000000 + ev[i].input_event_usec;
+		if (ev[i].type == EV_SYN && ev[i].code == SYN_DROPPED) {
+			// the kernel buffer overflowed, the slots are read again later
+			trace_lag();
+			p->dropped = true;
+		} else if (ev[i].type == EV_SYN && ev[i].code == SYN_REPORT) {
+			if (p->dropped) {
+				p->dropped = false;
+				records += evdev_parser_sync(p, time, handle, data);
+			} else {
+				records += flush(p, time, handle, data);
+			}
+		} else if (p->dropped || ev[i].type != EV_ABS) {
+			continue;
+		} else if (ev[i].code == ABS_MT_SLOT) {
+			p->slot = ev[i].value >= 0 && ev[i].value < MAX_SLOTS ? ev[i].value : -1;
+		} else if (p->slot < 0) {
+			continue;
+		} else if (ev[i].code == ABS_MT_TRACKING_ID) {
+			set_id(p, p->slot, ev[i].value);
+		} else if (ev[i].code == ABS_MT_POSITION_X || ev[i].code == ABS_MT_POSITION_Y) {
+			set_position(p, p->slot, ev[i].code == ABS_MT_POSITION_Y, ev[i].value);
+		}
+	}
+	return records;
+}
+
+typedef struct record_list {
+	touch_record *records;
+	size_t len;
+	size_t cap;
+} record_list;
+
+static void record_append(const touch_record *t, void *data) {
+	record_list *l = data;
+	if (l->len == l->cap) {
+		l->cap = l->cap ? l->cap * 2 : 1024;
+		l->records = realloc(l->records, l->cap * sizeof *l->records);
+	}
+	l->records[l->len++] = *t;
+}
+
+touch_record *evdev_load_evemu(const char *path, size_t *events, size_t *len) {
+	struct input_event *ev = NULL;
+	record_list l = {0};
+	evdev_axis axes[2] = {{0}};
+	evdev_parser *p;
+	size_t n = 0, cap = 0;
+	unsigned long sec, usec;
+	unsigned int type, code;
+	int32_t value, min, res, unused;
+	char line[512];
+	FILE *f = fopen(path, "re");
+	if (f == NULL) {
+		printf("Failed to open evemu recording %s\n", path);
+		return NULL;
+	}
+	while (fgets(line, sizeof line, f) != NULL) {
+		// A: <code> <min> <max> <fuzz> <flat> <resolution>
+		if (sscanf(line, "A: %x %d %d %d %d %d", &code, &min, &unused, &unused, &unused, &res) == 6) {
+			if (code == ABS_MT_POSITION_X || code == ABS_MT_POSITION_Y) {
+				axes[code == ABS_MT_POSITION_Y] = (evdev_axis){.min = min, .res = res};
+			}
+			continue;
+		}
+		// E: <sec>.<usec> <type> <code> <value>
+		if (sscanf(line, "E: %lu.%lu %x %x %d", &sec, &usec, &type, &code, &value) != 5) {
+			continue;
+		}
+		if (n == cap) {
+			cap = cap ? cap * 2 : 4096;
+			ev = realloc(ev, cap * sizeof *ev);
+		}
+		ev[n] = (struct input_event){.type = type, .code = code, .value = value};
+		ev[n].input_event_sec = sec;
+		ev[n].input_event_usec = usec;
+		n++;
+	}
+	fclose(f);
+	p = malloc(sizeof *p);
+	evdev_parser_init(p, axes[0], axes[1], -1, 0);
+	evdev_parse(p, ev, n, record_append, &l);
+	free(p);
+	free(ev);
+	*events = n;
+	*len = l.len;
+	return l.records;
+}
+
+typedef struct evdev_backend {
+	backend b;
+	int fd;
+	touch_device *dev;
+	evdev_parser parser;
+	frame_handler frame;  // handler of the running dispatch
+	void *data;
+} evdev_backend;
+
+static void evdev_record(const touch_record *t, void *data) {
+	evdev_backend *eb = data;
+	device_record(eb->dev, t);
+	if (t->type == TT_FRAME && eb->frame != NULL) {
+		eb->frame(eb->dev, eb->data);
+	}
+}
+
+static int evdev_backend_fd(backend *b) {
+	return ((evdev_backend *)b)->fd;
+}
+
+// parse all pending events, false if the device is gone
+static bool evdev_read(evdev_backend *eb, record_handler handle, void *data, size_t *events) {
+	struct input_event ev[EVDEV_BATCH];
+	ssize_t n;
+	*events = 0;
+	while ((n = read(eb->fd, ev, sizeof ev)) > 0) {
+		evdev_parse(&eb->parser, ev, n / sizeof *ev, handle, data);
+		*events += n / sizeof *ev;
+	}
+	return n != -1 || errno != ENODEV;
+}
+
+static void evdev_remove(evdev_backend *eb) {
+	printf("Device removed: %d\n", eb->dev->index);
+	device_detach(eb->dev);
+	close(eb->fd);
+	eb->dev = NULL;
+	eb->fd = -1;
+}
+
+static size_t evdev_backend_dispatch(backend *b, frame_handler frame, void *data) {
+	evdev_backend *eb = (evdev_backend *)b;
+	size_t events;
+	eb->frame = frame;
+	eb->data = data;
+	if (!evdev_read(eb, evdev_record, eb, &events)) {
+		evdev_remove(eb);
+	}
+	return events;
+}
+
+static size_t evdev_backend_drain(backend *b, const record_sink *sink) {
+	evdev_backend *eb = (evdev_backend *)b;
+	size_t events;
+	if (!evdev_read(eb, sink->record, sink->data, &events)) {
+		sink->lock(sink->data);
+		evdev_remove(eb);
+		sink->unlock(sink->data);
+	}
+	return events;
+}
+
+static void evdev_backend_destroy(backend *b) {
+	evdev_backend *eb = (evdev_backend *)b;
+	if (eb->dev != NULL) {
+		device_detach(eb->dev);
+		close(eb->fd);
+	}
+	free(eb);
+}
+
+backend *evdev_backend_new(const char *devpath) {
+	struct input_absinfo slot, x, y;
+	struct input_id id = {0};
+	char name[256] = "";
+	evdev_backend *eb;
+	double width, height;
+	int clock = CLOCK_MONOTONIC;
+	int fd = open(devpath, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd == -1) {
+		printf("Failed to open %s: %s\n", devpath, strerror(errno));
+		return NULL;
+	}
+	if (ioctl(fd, EVIOCGABS(ABS_MT_SLOT), &slot) == -1 ||
+	    ioctl(fd, EVIOCGABS(ABS_MT_POSITION_X), &x) == -1 ||
+	    ioctl(fd, EVIOCGABS(ABS_MT_POSITION_Y), &y) == -1) {
+		printf("%s is no multitouch protocol B device\n", devpath);
+		close(fd);
+		return NULL;
+	}
+	// same clock as libinput timestamps and the tracing
+	ioctl(fd, EVIOCSCLOCKID, &clock);
+	ioctl(fd, EVIOCGID, &id);
+	ioctl(fd, EVIOCGNAME(sizeof name - 1), name);
+	eb = calloc(1, sizeof *eb);
+	eb->b = (backend){
+		.name = "evdev",
+		.fd = evdev_backend_fd,
+		.dispatch = evdev_backend_dispatch,
+		.drain = evdev_backend_drain,
+		.destroy = evdev_backend_destroy,
+	};
+	eb->fd = fd;
+	// size is unknown without resolution, like in libinput
+	width = x.resolution > 0 ? (double)(x.maximum - x.minimum) / x.resolution : 0;
+	height = y.resolution > 0 ? (double)(y.maximum - y.minimum) / y.resolution : 0;
+	if ((eb->dev = device_attach(name, devpath, id.vendor, id.product, width, height, slot.maximum + 1)) == NULL) {
+		close(fd);
+		free(eb);
+		return NULL;
+	}
+	evdev_parser_init(&eb->parser, (evdev_axis){x.minimum, x.resolution},
+			  (evdev_axis){y.minimum, y.resolution}, fd, eb->dev->index);
+	// fingers already on the screen
+	evdev_parser_sync(&eb->parser, trace_now(), evdev_record, eb);
+	return &eb->b;
+}
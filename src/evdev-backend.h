@@ -0,0 +1,39 @@
+#ifndef EVDEV_BACKEND_H
+#define EVDEV_BACKEND_H
+#include "libinput-touchscreen.h"
+#include <linux/input.h>
+#include <stdbool.h>
+#include <stddef.h>
+#define EVDEV_BATCH 64  // input events read per syscall
+
+// position axis of a device
+typedef struct evdev_axis {
+	int32_t min;
+	int32_t res;  // units per mm
+} evdev_axis;
+
+// State of the multitouch protocol B stream of one device. Changes of a
+// slot are collected until SYN_REPORT and then turned into touch records
+// the way libinput reports them, followed by a frame.
+typedef struct evdev_parser {
+	evdev_axis x, y;
+	int fd;  // device to resync from after dropped events, -1 for none
+	uint8_t device;  // touchscreen index of the records
+	int32_t slot;  // slot of the following axis events, -1 if out of range
+	int32_t ids[MAX_SLOTS];  // tracking id of each slot, -1 if lifted
+	float posx[MAX_SLOTS], posy[MAX_SLOTS];  // position in mm
+	slotmask began, ended, moved;  // changes since the last SYN_REPORT
+	bool dropped;  // events are discarded until the next SYN_REPORT
+} evdev_parser;
+
+// Reset a parser for axes x and y, all slots lifted
+void evdev_parser_init(evdev_parser *p, evdev_axis x, evdev_axis y, int fd, uint8_t device);
+// Read all slots from the device and report their changes at time, for
+// opening and after dropped events
+size_t evdev_parser_sync(evdev_parser *p, uint64_t time, record_handler handle, void *data);
+// Feed n events, returns the number of touch records passed to handle
+size_t evdev_parse(evdev_parser *p, const struct input_event *ev, size_t n, record_handler handle, void *data);
+// Load the multitouch events of an evemu recording and convert them into
+// touch records of device 0, NULL on errors
+touch_record *evdev_load_evemu(const char *path, size_t *events, size_t *len);
+#endif
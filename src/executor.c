@@ -0,0 +1,114 @@
+#include "executor.h"
+#include "libinput-touchscreen.h"
+#include "realtime.h"
+
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+
+extern char **environ;
+
+typedef struct child {
+	pid_t pid;
+	uint64_t deadline;  // monotonic ms after which the child is killed, 0 for none
+} child;
+
+static child children[EXEC_MAX_CHILDREN];
+static size_t nchildren = 0;
+static size_t maxchildren = EXEC_DEFAULT_CHILDREN;
+static sigset_t origmask;
+
+static uint64_t now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void executor_init(size_t max_children, const sigset_t *childmask) {
+	if (max_children == 0 || max_children > EXEC_MAX_CHILDREN) {
+		max_children = EXEC_MAX_CHILDREN;
+	}
+	maxchildren = max_children;
+	origmask = *childmask;
+}
+
+int executor_spawn(const char *command, uint32_t timeout) {
+	posix_spawnattr_t attr;
+	pid_t pid;
+	int err;
+	char *argv[] = {"sh", "-c", (char *)command, NULL};
+
+	if (nchildren >= maxchildren) {
+		printf("Skip %s: %zu commands still running\n", command, nchildren);
+		return -1;
+	}
+
+	// children get their own process group, so a timeout kills the whole tree,
+	// and the signal mask from before signals were redirected to the signalfd
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setsigmask(&attr, &origmask);
+	// commands inherit the affinity, but not the priority of real-time mode
+	realtime_unpin();
+	err = posix_spawn(&pid, "/bin/sh", NULL, &attr, argv, environ);
+	realtime_pin();
+	posix_spawnattr_destroy(&attr);
+	if (err != 0) {
+		printf("Failed to launch %s: %s\n", command, strerror(err));
+		return -1;
+	}
+
+	children[nchildren].pid = pid;
+	children[nchildren].deadline = timeout ? now_ms() + timeout : 0;
+	nchildren++;
+	logger("Spawned %d, %zu running\n", pid, nchildren);
+	return 0;
+}
+
+// remove child at index by moving the last entry into its place
+static void remove_child(size_t i) {
+	children[i] = children[--nchildren];
+}
+
+void executor_reap(void) {
+	pid_t pid;
+	int status;
+
+	// signals coalesce, so collect every exited child
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		for (size_t i = 0; i < nchildren; i++) {
+			if (children[i].pid == pid) {
+				remove_child(i);
+				break;
+			}
+		}
+		logger("Reaped %d, %zu running\n", pid, nchildren);
+	}
+}
+
+uint64_t executor_expire(void) {
+	uint64_t now = now_ms();
+	uint64_t next = 0;
+	for (size_t i = 0; i < nchildren; i++) {
+		if (children[i].deadline == 0) {
+			continue;
+		}
+		if (children[i].deadline <= now) {
+			printf("Command %d timed out, killing it\n", children[i].pid);
+			kill(-children[i].pid, SIGKILL);
+			// still reaped through SIGCHLD, only clear the deadline here
+			children[i].deadline = 0;
+		} else if (next == 0 || children[i].deadline < next) {
+			next = children[i].deadline;
+		}
+	}
+	return next ? next * 1000 : UINT64_MAX;
+}
+
+size_t executor_running(void) {
+	return nchildren;
+}
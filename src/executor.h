@@ -0,0 +1,20 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#define EXEC_MAX_CHILDREN 64  // upper limit for concurrently running commands
+#define EXEC_DEFAULT_CHILDREN 8  // default cap of concurrently running commands
+
+// Set the concurrency cap and the signal mask restored in children
+void executor_init(size_t max_children, const sigset_t *childmask);
+// Launch command in the background, kill it after timeout ms (0 = never)
+int executor_spawn(const char *command, uint32_t timeout);
+// Collect exited children, call on SIGCHLD
+void executor_reap(void);
+// Kill overdue children and return the next deadline in monotonic us,
+// UINT64_MAX if none
+uint64_t executor_expire(void);
+// Number of currently running children
+size_t executor_running(void);
+#endif
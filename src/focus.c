@@ -0,0 +1,142 @@
+#include "focus.h"
+#include "libinput-touchscreen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+static xcb_connection_t *conn = NULL;
+static xcb_window_t root;
+static xcb_atom_t active_atom;
+// outstanding requests, sequence 0 if none
+static xcb_get_property_cookie_t active_cookie;
+static xcb_get_property_cookie_t class_cookie;
+static char class[64];
+static char instance[64];
+
+// drop the reply of an outstanding request that a new one replaces
+static void discard(xcb_get_property_cookie_t *cookie) {
+	if (cookie->sequence != 0) {
+		xcb_discard_reply(conn, cookie->sequence);
+		cookie->sequence = 0;
+	}
+}
+
+static void request_active(void) {
+	discard(&active_cookie);
+	active_cookie = xcb_get_property(conn, 0, root, active_atom, XCB_ATOM_WINDOW, 0, 1);
+	xcb_flush(conn);
+}
+
+static void request_class(xcb_window_t win) {
+	discard(&class_cookie);
+	class_cookie = xcb_get_property(conn, 0, win, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 128);
+	xcb_flush(conn);
+}
+
+int focus_init(void) {
+	xcb_intern_atom_reply_t *atom;
+	const char *name = "_NET_ACTIVE_WINDOW";
+	uint32_t mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+
+	conn = xcb_connect(NULL, NULL);
+	if (xcb_connection_has_error(conn)) {
+		printf("No X server, application profiles disabled\n");
+		xcb_disconnect(conn);
+		conn = NULL;
+		return -1;
+	}
+	root = xcb_setup_roots_iterator(xcb_get_setup(conn)).data->root;
+	// a single blocking round trip at startup
+	atom = xcb_intern_atom_reply(conn, xcb_intern_atom(conn, 0, strlen(name), name), NULL);
+	if (atom == NULL) {
+		focus_destroy();
+		return -1;
+	}
+	active_atom = atom->atom;
+	free(atom);
+	xcb_change_window_attributes(conn, root, XCB_CW_EVENT_MASK, &mask);
+	request_active();
+	return xcb_get_file_descriptor(conn);
+}
+
+int focus_fd(void) {
+	return conn != NULL ? xcb_get_file_descriptor(conn) : -1;
+}
+
+// take a finished reply for cookie, NULL if still pending
+static xcb_get_property_reply_t *poll_reply(xcb_get_property_cookie_t *cookie) {
+	void *reply = NULL;
+	xcb_generic_error_t *err = NULL;
+	if (cookie->sequence == 0 || !xcb_poll_for_reply(conn, cookie->sequence, &reply, &err)) {
+		return NULL;
+	}
+	cookie->sequence = 0;
+	free(err);
+	return reply;
+}
+
+bool focus_handle(void) {
+	xcb_generic_event_t *ev;
+	xcb_get_property_reply_t *reply;
+	bool changed = false;
+	const char *value;
+	int len, ilen;
+
+	if (conn == NULL) {
+		return false;
+	}
+	while ((ev = xcb_poll_for_event(conn)) != NULL) {
+		if ((ev->response_type & ~0x80) == XCB_PROPERTY_NOTIFY &&
+		    ((xcb_property_notify_event_t *)ev)->atom == active_atom) {
+			request_active();
+		}
+		free(ev);
+	}
+	if ((reply = poll_reply(&active_cookie)) != NULL) {
+		if (xcb_get_property_value_length(reply) == sizeof(xcb_window_t)) {
+			request_class(*(xcb_window_t *)xcb_get_property_value(reply));
+		} else {
+			// no active window
+			changed = class[0] != '\0' || instance[0] != '\0';
+			class[0] = instance[0] = '\0';
+		}
+		free(reply);
+	}
+	if ((reply = poll_reply(&class_cookie)) != NULL) {
+		// WM_CLASS holds instance and class as consecutive strings
+		value = xcb_get_property_value(reply);
+		len = xcb_get_property_value_length(reply);
+		ilen = strnlen(value, len);
+		snprintf(instance, sizeof instance, "%.*s", ilen, value);
+		snprintf(class, sizeof class, "%.*s", ilen < len ? (int)strnlen(value + ilen + 1, len - ilen - 1) : 0,
+			 ilen < len ? value + ilen + 1 : "");
+		changed = true;
+		free(reply);
+		logger("Focus %s (%s)\n", class, instance);
+	}
+	if (xcb_connection_has_error(conn)) {
+		printf("Lost X connection, application profiles disabled\n");
+		focus_destroy();
+		class[0] = instance[0] = '\0';
+		return true;
+	}
+	return changed;
+}
+
+const char *focus_class(void) {
+	return class;
+}
+
+const char *focus_instance(void) {
+	return instance;
+}
+
+void focus_destroy(void) {
+	if (conn != NULL) {
+		xcb_disconnect(conn);
+		conn = NULL;
+	}
+}
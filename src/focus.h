@@ -0,0 +1,21 @@
+#ifndef FOCUS_H
+#define FOCUS_H
+#include <stdbool.h>
+
+// Track the WM_CLASS of the active window through _NET_ACTIVE_WINDOW
+// property changes on the root window. Replies are collected without
+// blocking, the cached class is then available without any round trip.
+
+// Connect to the X server, returns the connection fd or -1 without X
+int focus_init(void);
+// Connection fd, -1 after the connection was lost
+int focus_fd(void);
+// Process pending X events and replies, true if the focused class changed
+bool focus_handle(void);
+// WM_CLASS class name of the active window, empty if unknown
+const char *focus_class(void);
+// WM_CLASS instance name of the active window, empty if unknown
+const char *focus_instance(void);
+// Close the X connection
+void focus_destroy(void);
+#endif
@@ -0,0 +1,384 @@
+#include "gesture.h"
+#include "ruleset.h"
+
+#include "trace.h"
+#include "update.h"
+
+#include <math.h>
+#include <stdio.h>
+
+static uint32_t hold_time = HOLD_DEFAULT;  // in ms
+static double edge_distance = MIN_EDGE_DISTANCE;  // in mm
+
+void print_timedelta(uint32_t timedelta) {
+	printf("Time %ds\n", timedelta);
+}
+
+void print_gesture(const gesture *g) {
+	if (g->type == GT_SHAPE) {
+		printf("G(%d) T%d S%d\n", g->num, g->type, g->shape);
+		return;
+	}
+	printf("G(%d) T%d D%d\n", g->num, g->type, g->dir);
+}
+
+int argmax(const size_t *arr, size_t len) {
+	size_t highest = 0;
+	int index = 0;
+	for (size_t i = 0; i < len; i++) {
+		if (arr[i] > highest) {
+			highest = arr[i];
+			index = i;
+		} else if (arr[i] == highest) {
+			index = -1;
+		}
+	}
+	return index;
+}
+
+enum DIRECTION movement_direction(const slots *s, slotmask ready) {
+	float dx[MAX_SLOTS] = {0}, dy[MAX_SLOTS] = {0};
+	uint8_t dirs[MAX_SLOTS];
+	size_t enum_votes[DIR_NUM] = {0}, n = 0, i;
+	int dir;
+	while (ready) {
+		i = slotmask_pop(&ready);
+		dx[n] = s->endx[i] - s->startx[i];
+		dy[n] = s->endy[i] - s->starty[i];
+		n++;
+	}
+	// classify all slots at once, then collect votes
+	classify_directions(dx, dy, n, dirs);
+	for (i = 0; i < n; i++) {
+		enum_votes[dirs[i]]++;
+	}
+	// check if multiple directions had the same maximum vote
+	if ((dir = argmax(enum_votes, DIR_NUM)) < 0) {
+		dir = DIR_NONE;
+	}
+	return dir;
+}
+
+enum DIRECTION border_direction(const movement *cm, const movement *screen) {
+	if (movement_length(cm) < edge_distance) {
+		return DIR_NONE;
+	}
+	return edge_direction(cm->start, screen);
+}
+
+enum DIRECTION edge_direction(vec2 startvec, const movement *screen) {
+	if (startvec.x <= screen->start.x) {
+		return DIR_LEFT;
+	}
+	if (startvec.x >= screen->end.x) {
+		return DIR_RIGHT;
+	}
+	if (startvec.y <= screen->start.y) {
+		return DIR_TOP;
+	}
+	if (startvec.y >= screen->end.y) {
+		return DIR_BOT;
+	}
+	return DIR_NONE;
+}
+
+enum DIRECTION movement_border_direction(const slots *s, slotmask ready, movement *screen) {
+	enum DIRECTION dir;
+	movement m;
+	logger("Movement border dir: start\n");
+	while (ready) {
+		m = slot_movement(s, slotmask_pop(&ready));
+		if ((dir = border_direction(&m, screen)) != DIR_NONE) {
+			return dir;
+		}
+	}
+	logger("Movement border dir: end\n");
+	return DIR_NONE;
+}
+
+gesture get_gesture(const slots *s, movement *screen, slotmask ready) {
+	logger("Get gesture: begin\n");
+	gesture g = {0};
+	g.num = __builtin_popcountll(ready);
+	logger("Get gesture: %d fingers\n", g.num);
+	g.dir = movement_direction(s, ready);
+	enum DIRECTION border_dir;
+	logger("Get gesture: got dir\n");
+	if (g.dir == DIR_NONE) {
+		g.type = GT_TAP;
+	} else if (g.num > 1) {
+		g.type = GT_MOVEMENT;
+	} else if ((border_dir = movement_border_direction(s, ready, screen)) != DIR_NONE) {
+		g.type = GT_BORDER;
+		g.dir = border_dir;
+	}
+	logger("Get gesture: end\n");
+	return g;
+}
+
+// zones all fingers touched down in, 0 without zones or calibration
+static zonemask start_zones(const slots *s, slotmask fingers, const movement *screen, const ruleset *rules) {
+	float w = screen->end.x - screen->start.x, h = screen->end.y - screen->start.y;
+	zonemask zones = ~(zonemask)0;
+	movement m;
+	if (rules->grid == NULL || w <= 0 || h <= 0) {
+		return 0;
+	}
+	while (fingers && zones) {
+		m = slot_movement(s, slotmask_pop(&fingers));
+		zones &= zone_lookup(rules->grid, (m.start.x - screen->start.x) / w, (m.start.y - screen->start.y) / h);
+	}
+	return zones;
+}
+
+bool prune_sequence(slots *s, const movement *screen, const ruleset *rules) {
+	const interest *w = &rules->want;
+	slotmask fingers = s->down | s->ready;
+	size_t n = __builtin_popcountll(fingers);
+	zonemask zones;
+	if (s->pruned || !s->touched) {
+		return s->pruned;
+	}
+	s->touched = false;
+	// finger counts only grow until all fingers are lifted
+	if (n <= w->fingers) {
+		return false;
+	}
+	if (w->border && n == 1 && edge_direction(slot_movement(s, __builtin_ctzll(fingers)).start, screen) != DIR_NONE) {
+		return false;
+	}
+	zones = start_zones(s, fingers, screen, rules);
+	while (zones) {
+		if (n <= w->zoned[__builtin_ctz(zones)]) {
+			return false;
+		}
+		zones &= zones - 1;
+	}
+	s->pruned = true;
+	trace_pruned_sequence();
+	logger("Pruned sequence of %lu fingers\n", n);
+	return true;
+}
+
+void set_edge_distance(double mm) {
+	edge_distance = mm > 0 ? mm : MIN_EDGE_DISTANCE;
+}
+
+bool shape_gesture(const slots *s, slotmask ready, const ruleset *rules, gesture *g) {
+	float x[SLOT_TRAIL], y[SLOT_TRAIL];
+	shape stroke;
+	gesture sg = {.type = GT_SHAPE, .num = __builtin_popcountll(ready)};
+	int index = -1, i;
+	if (rules->ntemplates == 0 || sg.num > RULE_MAX_FINGERS) {
+		return false;
+	}
+	// all fingers have to draw the same shape
+	while (ready) {
+		if (!shape_from_path(x, y, slot_trail(s, slotmask_pop(&ready), x, y), &stroke)) {
+			return false;
+		}
+		i = shape_match(&stroke, rules->templates, rules->ntemplates);
+		if (i < 0 || (index >= 0 && i != index)) {
+			return false;
+		}
+		index = i;
+	}
+	sg.shape = index;
+	if (ruleset_match(rules, &sg) == NULL) {
+		return false;
+	}
+	*g = sg;
+	return true;
+}
+
+bool handle_movements(slots *s, movement *screen, const ruleset *rules, gesture *g) {
+	// skip if some fingers are still on the screen
+	if (any_down(s)) {
+		logger("SKIP handle movements: any down\n");
+		return false;
+	}
+	slotmask ready = get_ready_movements(s);
+	if (ready == 0) {
+		logger("SKIP handle movements: none ready\n");
+		return false;
+	}
+	logger("Handle movements: begin\n");
+	// gesture was already triggered by handle_streaming
+	if (ready & s->committed) {
+		logger("SKIP handle movements: committed before lift\n");
+		return false;
+	}
+	// shapes with a rule take precedence over plain movements
+	if (!shape_gesture(s, ready, rules, g)) {
+		*g = get_gesture(s, screen, ready);
+		g->zones = start_zones(s, ready, screen, rules);
+	}
+	logger("Handle movements: got gesture\n");
+	logger("Handle movements: end\n");
+	return true;
+}
+
+bool handle_streaming(slots *s, movement *screen, const ruleset *rules, gesture *g) {
+	const rule *r;
+	double minlen = -1, len;
+	slotmask down = s->down;
+	uint32_t latest = s->changed;
+	movement m;
+	enum DIRECTION dir = DIR_NONE, d;
+	size_t i;
+
+	// once a finger lifted, the gesture of all fingers is recognized on lift
+	if (!rules->streaming || down == 0 || s->ready != 0 || s->pruned || (down & s->committed)) {
+		return false;
+	}
+	// all fingers on the screen have to agree on a direction
+	while (down) {
+		i = slotmask_pop(&down);
+		latest = s->tend[i] > latest ? s->tend[i] : latest;
+		m = slot_movement(s, i);
+		d = movement_vector_direction(&m);
+		if (d == DIR_NONE || (dir != DIR_NONE && d != dir)) {
+			return false;
+		}
+		dir = d;
+		len = movement_length(&m);
+		minlen = minlen < 0 || len < minlen ? len : minlen;
+	}
+	// more fingers of the gesture may still be landing
+	if (latest - s->changed < EARLY_SETTLE) {
+		return false;
+	}
+
+	g->num = __builtin_popcountll(s->down);
+	g->dir = dir;
+	g->type = GT_MOVEMENT;
+	if (g->num == 1) {
+		g->dir = border_direction(&m, screen);
+		g->type = g->dir == DIR_NONE ? GT_NONE : GT_BORDER;
+	}
+	g->zones = start_zones(s, s->down, screen, rules);
+	r = ruleset_match(rules, g);
+	if (r == NULL || r->early <= 0 || minlen < r->early) {
+		return false;
+	}
+	s->committed |= s->down;
+	logger("Handle streaming: committed early\n");
+	return true;
+}
+
+void set_hold_time(uint32_t ms) {
+	hold_time = ms ? ms : HOLD_DEFAULT;
+}
+
+uint64_t hold_deadline(const slots *s, const ruleset *rules) {
+	if (!rules->timed || s->down == 0 || s->held || s->pruned || (s->down & s->committed)) {
+		return UINT64_MAX;
+	}
+	return s->still + (uint64_t)hold_time * 1000;
+}
+
+bool handle_hold(slots *s, movement *screen, const ruleset *rules, uint64_t now, gesture *g) {
+	slotmask down = s->down, rest = down;
+	enum DIRECTION edge = DIR_NUM, e;
+	bool moved = false;
+	movement m;
+	if (hold_deadline(s, rules) > now) {
+		return false;
+	}
+	s->held = true;
+	// longpresses are anchored to an edge if all fingers touched down there
+	while (rest) {
+		m = slot_movement(s, slotmask_pop(&rest));
+		moved |= movement_length(&m) >= HOLD_SLOP;
+		e = edge_direction(m.start, screen);
+		edge = edge == DIR_NUM || edge == e ? e : DIR_NONE;
+	}
+	*g = (gesture){.type = GT_LONGPRESS, .dir = edge, .num = __builtin_popcountll(down)};
+	if (moved) {
+		g->type = GT_HOLD;
+		g->dir = movement_direction(s, down);
+	}
+	g->zones = start_zones(s, down, screen, rules);
+	if (ruleset_match(rules, g) == NULL) {
+		logger("SKIP handle hold: no rule\n");
+		return false;
+	}
+	s->committed |= down;
+	logger("Handle hold: committed\n");
+	return true;
+}
+
+// spread and angle of the fingers, from their current positions
+static void finger_geometry(const slots *s, slotmask fingers, float *spread, float *angle) {
+	slotmask rest = fingers;
+	size_t n = __builtin_popcountll(fingers), i, first = 0, second = 0;
+	float cx = 0, cy = 0, sum = 0;
+	while (rest) {
+		i = slotmask_pop(&rest);
+		cx += s->endx[i];
+		cy += s->endy[i];
+	}
+	cx /= n;
+	cy /= n;
+	rest = fingers;
+	while (rest) {
+		i = slotmask_pop(&rest);
+		sum += sqrtf((s->endx[i] - cx) * (s->endx[i] - cx) + (s->endy[i] - cy) * (s->endy[i] - cy));
+	}
+	*spread = sum / n;
+	rest = fingers;
+	first = slotmask_pop(&rest);
+	second = slotmask_pop(&rest);
+	// y points down, so counter-clockwise rotation is positive
+	*angle = atan2f(s->endy[first] - s->endy[second], s->endx[second] - s->endx[first]) * 180 / M_PI;
+}
+
+bool handle_continuous(slots *s, const ruleset *rules, continuous *c, uint64_t now) {
+	gesture g = {.dir = DIR_NONE, .num = __builtin_popcountll(s->down)};
+	const rule *pinch, *rotate;
+	float spread, angle, dspread, dangle;
+
+	if (!rules->continuous || g.num < 2 || s->pruned) {
+		*c = (continuous){0};
+		return false;
+	}
+	g.type = GT_PINCH;
+	pinch = ruleset_match(rules, &g);
+	g.type = GT_ROTATE;
+	rotate = ruleset_match(rules, &g);
+	// other gestures already took these fingers
+	if ((pinch == NULL && rotate == NULL) || (!c->active && (s->down & s->committed))) {
+		return false;
+	}
+	finger_geometry(s, s->down, &spread, &angle);
+	if (c->fingers != s->down) {
+		c->fingers = s->down;
+		c->spread = spread;
+		c->angle = angle;
+		return false;
+	}
+	dspread = spread - c->spread;
+	dangle = remainderf(angle - c->angle, 360);
+	c->spread = spread;
+	c->angle = angle;
+	c->pinch += dspread;
+	c->rotate += dangle;
+	if (!c->active) {
+		if (fabsf(c->pinch) < PINCH_START && fabsf(c->rotate) < ROTATE_START) {
+			return false;
+		}
+		// the first update carries the change up to the threshold
+		dspread = c->pinch;
+		dangle = c->rotate;
+		c->active = true;
+		s->committed |= s->down;
+	}
+	// skip rounding noise of the other kind of change
+	if (pinch != NULL && fabsf(dspread) >= CONTINUOUS_MIN) {
+		update_add(pinch, dspread, now);
+	}
+	if (rotate != NULL && fabsf(dangle) >= CONTINUOUS_MIN) {
+		update_add(rotate, dangle, now);
+	}
+	return true;
+}
@@ -0,0 +1,54 @@
+#ifndef GESTURE_H
+#define GESTURE_H
+#include "libinput-touchscreen.h"
+#include "ruleset.h"
+
+// Reference of a continuous gesture, updated every frame
+typedef struct continuous {
+	slotmask fingers;  // fingers the reference belongs to
+	float spread;  // mean distance of the fingers from their centroid in mm
+	float angle;  // angle of the line through the two lowest fingers in degrees
+	float pinch, rotate;  // change since the fingers touched down
+	bool active;  // thresholds were passed, updates are sent
+} continuous;
+
+void print_timedelta(uint32_t timedelta);
+void print_gesture(const gesture *g);
+
+// Majority direction of all ready movements, DIR_NONE on ties
+enum DIRECTION movement_direction(const slots *s, slotmask ready);
+// Border side a movement started from, DIR_NONE if none or too short
+enum DIRECTION border_direction(const movement *cm, const movement *screen);
+// Screen edge a point lies on, DIR_NONE if none
+enum DIRECTION edge_direction(vec2 startvec, const movement *screen);
+// Border side a ready movement started from, DIR_NONE if none
+enum DIRECTION movement_border_direction(const slots *s, slotmask ready, movement *screen);
+// Stop recognizing the touch sequence once a finger touched down that no
+// rule can match, by finger count or start region. True if the sequence is
+// pruned, it then stays pruned until all fingers are lifted.
+bool prune_sequence(slots *s, const movement *screen, const ruleset *rules);
+// Shortest border gesture in mm, 0 for the default
+void set_edge_distance(double mm);
+// Classify ready movements into a gesture
+gesture get_gesture(const slots *s, movement *screen, slotmask ready);
+// Match the paths of ready movements against the shape templates, true if
+// all fingers drew the same shape and a rule exists for it
+bool shape_gesture(const slots *s, slotmask ready, const ruleset *rules, gesture *g);
+// Recognize a gesture once all fingers are lifted, true if g was filled
+bool handle_movements(slots *s, movement *screen, const ruleset *rules, gesture *g);
+// Recognize a gesture before lift for rules with the early option, true if
+// g was filled. The gesture is then not recognized again on lift.
+bool handle_streaming(slots *s, movement *screen, const ruleset *rules, gesture *g);
+// Time in ms fingers rest before hold gestures fire, 0 for the default
+void set_hold_time(uint32_t ms);
+// Time in us at which resting fingers are evaluated for hold gestures,
+// UINT64_MAX if there are none or they were already evaluated
+uint64_t hold_deadline(const slots *s, const ruleset *rules);
+// Recognize HOLD or LONGPRESS of fingers resting since the deadline before
+// now, true if g was filled. The gesture is then not recognized again on lift.
+bool handle_hold(slots *s, movement *screen, const ruleset *rules, uint64_t now, gesture *g);
+// Compute pinch and rotate deltas of the down fingers since the last frame
+// and add them to the pending updates of their rules, time in us. Once
+// updates are sent the touch sequence is not recognized again on lift.
+bool handle_continuous(slots *s, const ruleset *rules, continuous *c, uint64_t now);
+#endif
@@ -1,6 +1,9 @@
 #include "libinput-backend.h"
+#include "backend.h"
+#include "trace.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -17,6 +20,17 @@ static void close_restricted(int fd, void *user_data) {
 	close(fd);
 }
 
+// count lag reports and print errors, libinput stays quiet otherwise
+static void log_handler(struct libinput *li, enum libinput_log_priority priority,
+			const char *format, va_list args) {
+	if (strstr(format, "lagging behind") != NULL) {
+		trace_lag();
+	}
+	if (priority >= LIBINPUT_LOG_PRIORITY_ERROR) {
+		vfprintf(stderr, format, args);
+	}
+}
+
 const static struct libinput_interface interface = {
 	.open_restricted = open_restricted,
 	.close_restricted = close_restricted,
@@ -27,72 +41,134 @@ char *get_devpath(struct libinput_device *dev) {
 	const char *origpath = udev_device_get_devnode(uddev);
 	size_t plen = strlen(origpath);
 	char *devpath = malloc((plen + 1) * sizeof *devpath);
-	memcpy(devpath, origpath, plen);
+	memcpy(devpath, origpath, plen + 1);
 	udev_device_unref(uddev);
 	return devpath;
 }
 
-// Check event for device, if device is touchscreen set devpath and return true
-bool check_is_touchscreen(struct libinput_event *ev, char **devpath) {
-	bool is_touch = false;
-	struct libinput_device *dev;
-	if (libinput_event_get_type(ev) == LIBINPUT_EVENT_DEVICE_ADDED) {
-		dev = libinput_event_get_device(ev);
-		if (libinput_device_has_capability(dev,
-						   LIBINPUT_DEVICE_CAP_TOUCH)) {
-			*devpath = get_devpath(dev);
-			is_touch = true;
-		}
+void clear_event_pipe(struct libinput *li) {
+	struct libinput_event *event;
+	// clear up event pipeline
+	libinput_dispatch(li);
+	while ((event = libinput_get_event(li)) != NULL) {
+		libinput_event_destroy(event);
+		libinput_dispatch(li);
 	}
-	libinput_event_destroy(ev);
-	return is_touch;
 }
 
-char *find_touch_device() {
+struct libinput *create_libinput_device_interface(const char *devpath) {
 	struct libinput *li;
-	struct libinput_event *ev;
-	char *devicepath = NULL;
+	struct libinput_device *dev;
 
-	struct udev *ud;
+	li = libinput_path_create_context(&interface, NULL);
+	// lag reports are logged at info priority
+	libinput_log_set_handler(li, log_handler);
+	libinput_log_set_priority(li, LIBINPUT_LOG_PRIORITY_INFO);
 
-	ud = udev_new();
+	dev = libinput_path_add_device(li, devpath);
+	if (dev == NULL) {
+		printf("Error in device adding %s\n", devpath);
+		return NULL;
+	}
+	return li;
+}
+
+struct libinput *create_libinput_seat_interface(const char *seat) {
+	struct libinput *li;
+	struct udev *ud = udev_new();
+
+	// libinput keeps its own reference to udev for hotplug monitoring
 	li = libinput_udev_create_context(&interface, NULL, ud);
+	udev_unref(ud);
+	if (li == NULL) {
+		printf("Error creating udev context\n");
+		return NULL;
+	}
+	libinput_log_set_handler(li, log_handler);
+	libinput_log_set_priority(li, LIBINPUT_LOG_PRIORITY_INFO);
+	if (libinput_udev_assign_seat(li, seat) != 0) {
+		printf("Error assigning seat %s\n", seat);
+		libinput_unref(li);
+		return NULL;
+	}
+	return li;
+}
+
+typedef struct libinput_backend {
+	backend b;
+	struct libinput *li;
+} libinput_backend;
 
-	libinput_udev_assign_seat(li, "seat0");
+static int libinput_backend_fd(backend *b) {
+	return libinput_get_fd(((libinput_backend *)b)->li);
+}
 
+static size_t libinput_backend_dispatch(backend *b, frame_handler frame, void *data) {
+	struct libinput *li = ((libinput_backend *)b)->li;
+	struct libinput_event *event;
+	touch_device *d;
+	size_t events = 0;
+	// read everything the kernel has once, then drain the queue
 	libinput_dispatch(li);
-	while ((ev = libinput_get_event(li))) {
-		if (check_is_touchscreen(ev, &devicepath)) {
-			break;
+	while ((event = libinput_get_event(li)) != NULL) {
+		if ((d = device_handle_event(event)) != NULL) {
+			frame(d, data);
 		}
-		libinput_dispatch(li);
+		libinput_event_destroy(event);
+		events++;
 	}
-
-	udev_unref(ud);
-	libinput_unref(li);
-	return devicepath;
+	return events;
 }
 
-void clear_event_pipe(struct libinput *li) {
+static size_t libinput_backend_drain(backend *b, const record_sink *sink) {
+	struct libinput *li = ((libinput_backend *)b)->li;
 	struct libinput_event *event;
-	// clear up event pipeline
+	touch_device *d;
+	touch_record t;
+	size_t events = 0;
 	libinput_dispatch(li);
 	while ((event = libinput_get_event(li)) != NULL) {
+		switch (libinput_event_get_type(event)) {
+		case LIBINPUT_EVENT_DEVICE_ADDED:
+		case LIBINPUT_EVENT_DEVICE_REMOVED:
+			sink->lock(sink->data);
+			device_handle_event(event);
+			sink->unlock(sink->data);
+			break;
+		default:
+			t = (touch_record){0};
+			d = libinput_device_get_user_data(libinput_event_get_device(event));
+			if (d != NULL && touch_from_event(event, &t)) {
+				t.device = d->index;
+				sink->record(&t, sink->data);
+			}
+			break;
+		}
 		libinput_event_destroy(event);
-		libinput_dispatch(li);
+		events++;
 	}
+	return events;
 }
 
-struct libinput *create_libinput_device_interface(const char *devpath) {
-	struct libinput *li;
-	struct libinput_device *dev;
-
-	li = libinput_path_create_context(&interface, NULL);
+static void libinput_backend_destroy(backend *b) {
+	libinput_unref(((libinput_backend *)b)->li);
+	free(b);
+}
 
-	dev = libinput_path_add_device(li, devpath);
-	if (dev == NULL) {
-		printf("Error in device adding %s\n", devpath);
+backend *libinput_backend_new(const char *seat) {
+	libinput_backend *lb;
+	struct libinput *li = create_libinput_seat_interface(seat);
+	if (li == NULL) {
 		return NULL;
 	}
-	return li;
+	lb = calloc(1, sizeof *lb);
+	lb->b = (backend){
+		.name = "libinput",
+		.fd = libinput_backend_fd,
+		.dispatch = libinput_backend_dispatch,
+		.drain = libinput_backend_drain,
+		.destroy = libinput_backend_destroy,
+	};
+	lb->li = li;
+	return &lb->b;
 }
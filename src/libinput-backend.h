@@ -9,6 +9,9 @@ void clear_event_pipe(struct libinput *li);
 // Create a libinput device interface
 struct libinput *create_libinput_device_interface(const char *devpath);
 
-// Find a touchscreen device and return the devicepath
-char *find_touch_device();
+// Create a libinput interface for all devices of a seat, including hotplugged ones
+struct libinput *create_libinput_seat_interface(const char *seat);
+
+// Device node path of a libinput device
+char *get_devpath(struct libinput_device *dev);
 #endif
@@ -1,7 +1,10 @@
 #include "libinput-touchscreen.h"
+#include "capture.h"
+#include "trace.h"
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if LOGGING
@@ -79,10 +82,38 @@ enum GESTTYPE str_to_gesttype(const char *s) {
 	if (strncmp(s, "TAP", 16) == 0) {
 		return GT_TAP;
 	}
+	if (strncmp(s, "HOLD", 16) == 0) {
+		return GT_HOLD;
+	}
+	if (strncmp(s, "LONGPRESS", 16) == 0) {
+		return GT_LONGPRESS;
+	}
+	if (strncmp(s, "PINCH", 16) == 0) {
+		return GT_PINCH;
+	}
+	if (strncmp(s, "ROTATE", 16) == 0) {
+		return GT_ROTATE;
+	}
+	if (strncmp(s, "SHAPE", 16) == 0) {
+		return GT_SHAPE;
+	}
 	return GT_NONE;
 }
 
 enum DIRECTION str_to_direction(const char *s) {
+	// same swapped east and west as the main directions
+	if (strncmp(s, "NE", 16) == 0) {
+		return DIR_TOP_LEFT;
+	}
+	if (strncmp(s, "NW", 16) == 0) {
+		return DIR_TOP_RIGHT;
+	}
+	if (strncmp(s, "SE", 16) == 0) {
+		return DIR_BOT_LEFT;
+	}
+	if (strncmp(s, "SW", 16) == 0) {
+		return DIR_BOT_RIGHT;
+	}
 	if (strncmp(s, "N", 16) == 0) {
 		return DIR_TOP;
 	}
@@ -116,76 +147,271 @@ enum DIRECTION angle_to_direction(double angle) {
 	return DIR_RIGHT;
 }
 
-void handle_event(struct libinput_event *event, movement *m) {
-	int32_t slot;
+#define TAN_PI8 0.41421356f  // boundary between main and diagonal directions
+
+static int direction_mode = 4;
+static float deadzone_sq = 0;
+
+void set_direction_mode(int directions, double deadzone) {
+	direction_mode = directions == 8 ? 8 : 4;
+	deadzone_sq = deadzone * deadzone;
+}
+
+// 4 directions with the same boundaries as angle_to_direction, diagonals
+// belong to the direction counter-clockwise of them
+static inline uint8_t direction4(float dx, float dy) {
+	float u = -dy;  // y axis points down
+	int right = u >= 0 ? dx >= u : dx > dy;
+	int left = u >= 0 ? dx < -u : dx <= u;
+	int vertical = !right && !left, none = dx * dx + dy * dy <= deadzone_sq;
+	// arithmetic select instead of branches, directions are unpredictable
+	int dir = right * DIR_RIGHT + left * DIR_LEFT + vertical * (u > 0 ? DIR_TOP : DIR_BOT);
+	return !none * dir;
+}
+
+static inline uint8_t direction8(float dx, float dy) {
+	float adx = fabsf(dx), ady = fabsf(dy);
+	int horizontal = ady <= TAN_PI8 * adx;
+	int vertical = adx <= TAN_PI8 * ady;
+	int none = dx * dx + dy * dy <= deadzone_sq;
+	int up = dy < 0, right = dx > 0;
+	int diagonal = up ? (right ? DIR_TOP_RIGHT : DIR_TOP_LEFT) : (right ? DIR_BOT_RIGHT : DIR_BOT_LEFT);
+	int dir = horizontal * (right ? DIR_RIGHT : DIR_LEFT) +
+	          (!horizontal && vertical) * (up ? DIR_TOP : DIR_BOT) +
+	          (!horizontal && !vertical) * diagonal;
+	return !none * dir;
+}
+
+enum DIRECTION vector_direction(float dx, float dy) {
+	return direction_mode == 8 ? direction8(dx, dy) : direction4(dx, dy);
+}
 
+void classify_directions(const float *dx, const float *dy, size_t n, uint8_t *dirs) {
+	// separate branch free loops, so the compiler can vectorize them
+	if (direction_mode == 8) {
+		for (size_t i = 0; i < n; i++) {
+			dirs[i] = direction8(dx[i], dy[i]);
+		}
+	} else {
+		for (size_t i = 0; i < n; i++) {
+			dirs[i] = direction4(dx[i], dy[i]);
+		}
+	}
+}
+
+enum DIRECTION movement_vector_direction(const movement *m) {
+	return vector_direction(m->end.x - m->start.x, m->end.y - m->start.y);
+}
+
+bool touch_from_event(struct libinput_event *event, touch_record *t) {
 	struct libinput_event_touch *tevent;
 
 	switch(libinput_event_get_type(event)) {
 	case LIBINPUT_EVENT_TOUCH_DOWN:
-		tevent = libinput_event_get_touch_event(event);
-		slot = libinput_event_touch_get_slot(tevent);
-		m[slot].start.x = libinput_event_touch_get_x(tevent);
-		m[slot].start.y = libinput_event_touch_get_y(tevent);
-		m[slot].tstart = libinput_event_touch_get_time(tevent);
-		m[slot].end.x = m[slot].start.x;
-		m[slot].end.y = m[slot].start.y;
-		m[slot].tend = m[slot].tstart;
-		m[slot].down = true;
-		logger("%d down\n", slot);
+		t->type = TT_DOWN;
 		break;
 	case LIBINPUT_EVENT_TOUCH_UP:
-		tevent = libinput_event_get_touch_event(event);
-		slot = libinput_event_touch_get_slot(tevent);
-		m[slot].ready = true;
-		m[slot].down = false;
-		logger("%d up\n", slot);
+		t->type = TT_UP;
 		break;
 	case LIBINPUT_EVENT_TOUCH_CANCEL:
-		tevent = libinput_event_get_touch_event(event);
-		slot = libinput_event_touch_get_slot(tevent);
-		m[slot].ready = false;
-		m[slot].down = false;
-		logger("%dTouch cancel.\n", slot);
+		t->type = TT_CANCEL;
 		break;
 	case LIBINPUT_EVENT_TOUCH_MOTION:
-		tevent = libinput_event_get_touch_event(event);
-		slot = libinput_event_touch_get_slot(tevent);
-		m[slot].end.x = libinput_event_touch_get_x(tevent);
-		m[slot].end.y = libinput_event_touch_get_y(tevent);
-		m[slot].tend = libinput_event_touch_get_time(tevent);
-		logger("%d Motion\n", slot);
+		t->type = TT_MOTION;
 		break;
 	case LIBINPUT_EVENT_TOUCH_FRAME:
+		t->type = TT_FRAME;
+		break;
+	default:
+		return false;
+	}
+	tevent = libinput_event_get_touch_event(event);
+	t->time = libinput_event_touch_get_time_usec(tevent);
+	t->slot = 0;
+	t->x = 0;
+	t->y = 0;
+	// slot and coordinates are only valid for some event types
+	if (t->type != TT_FRAME) {
+		t->slot = libinput_event_touch_get_slot(tevent);
+	}
+	if (t->type == TT_DOWN || t->type == TT_MOTION) {
+		t->x = libinput_event_touch_get_x(tevent);
+		t->y = libinput_event_touch_get_y(tevent);
+	}
+	return true;
+}
+
+// append a path point, unless it is closer than TRAIL_STEP to the last one
+static void trail_push(slots *s, size_t i, float x, float y) {
+	size_t n = s->trailn[i], k = i * SLOT_TRAIL + (n - 1) % SLOT_TRAIL;
+	float dx = x - s->trailx[k], dy = y - s->traily[k];
+	if (n > 0 && dx * dx + dy * dy < TRAIL_STEP * TRAIL_STEP) {
+		return;
+	}
+	k = i * SLOT_TRAIL + n % SLOT_TRAIL;
+	s->trailx[k] = x;
+	s->traily[k] = y;
+	s->trailn[i] = n + 1;
+}
+
+// start a new rest of all fingers at their current positions
+static void rest(slots *s, uint64_t time) {
+	slotmask down = s->down;
+	size_t i;
+	while (down) {
+		i = slotmask_pop(&down);
+		s->anchorx[i] = s->endx[i];
+		s->anchory[i] = s->endy[i];
+	}
+	s->still = time;
+	s->held = false;
+}
+
+void handle_touch(const touch_record *t, slots *s) {
+	int32_t slot = t->slot < 0 ? 0 : t->slot;
+	slotmask bit;
+
+	if (slot >= (int32_t)s->capacity) {
+		logger("%d beyond slot capacity\n", slot);
+		return;
+	}
+	bit = (slotmask)1 << slot;
+	// pruned sequences only track which fingers are down
+	if (s->pruned && (t->type == TT_MOTION || t->type == TT_FRAME)) {
+		trace_pruned_event();
+		return;
+	}
+	switch(t->type) {
+	case TT_DOWN:
+		s->touched = true;
+		s->startx[slot] = s->endx[slot] = t->x;
+		s->starty[slot] = s->endy[slot] = t->y;
+		s->tstart[slot] = s->tend[slot] = t->time / 1000;
+		s->down |= bit;
+		s->committed &= ~bit;
+		s->trailn[slot] = 0;
+		trail_push(s, slot, t->x, t->y);
+		s->changed = t->time / 1000;
+		rest(s, t->time);
+		logger("%d down\n", slot);
+		break;
+	case TT_UP:
+		s->ready |= bit;
+		s->down &= ~bit;
+		s->changed = t->time / 1000;
+		rest(s, t->time);
+		logger("%d up\n", slot);
+		break;
+	case TT_CANCEL:
+		s->ready &= ~bit;
+		s->down &= ~bit;
+		s->changed = t->time / 1000;
+		rest(s, t->time);
+		logger("%dTouch cancel.\n", slot);
+		break;
+	case TT_MOTION:
+		s->endx[slot] = t->x;
+		s->endy[slot] = t->y;
+		s->tend[slot] = t->time / 1000;
+		trail_push(s, slot, t->x, t->y);
+		if ((t->x - s->anchorx[slot]) * (t->x - s->anchorx[slot]) +
+		    (t->y - s->anchory[slot]) * (t->y - s->anchory[slot]) > HOLD_SLOP * HOLD_SLOP) {
+			rest(s, t->time);
+		}
+		logger("%d Motion\n", slot);
+		break;
+	case TT_FRAME:
 		logger("Touch frame\n");
 		break;
 	default:
-		printf("Unknown event type. %d\n", libinput_event_get_type(event));
 		break;
 	}
+	// a pruned sequence ends with its last finger, without recognition
+	if (s->pruned && s->down == 0) {
+		s->ready = 0;
+		s->pruned = false;
+	}
 }
 
-// Get all movement slots that are currently ready
-list *get_ready_movements(struct movement *m) {
-	list *ready = NULL;
-	for (size_t i = 0; i < MOV_SLOTS; i++) {
-		if (m[i].ready) {
-			if (ready == NULL) {
-				ready = list_new(&i, sizeof(i));
-			} else {
-				list_append(ready, &i, sizeof(i));
-			}
-			m[i].ready = false;
-		}
+void handle_record(const touch_record *t, slots *s) {
+	if (t->type == TT_UP) {
+		trace_up(t->time);
+	} else if (t->type == TT_FRAME) {
+		trace_frame(t->time);
 	}
-	return ready;
+	capture_write(t);
+	handle_touch(t, s);
 }
 
-bool any_down(struct movement *m) {
-	for (size_t i = 0; i < MOV_SLOTS; i++){
-		if (m[i].down) {
-			return true;
-		}
+void handle_event(struct libinput_event *event, slots *s, uint8_t device) {
+	touch_record t = {.device = device};
+	if (!touch_from_event(event, &t)) {
+		printf("Unknown event type. %d\n", libinput_event_get_type(event));
+		return;
 	}
-	return false;
+	handle_record(&t, s);
+}
+
+slots *slots_new(size_t capacity) {
+	slots *s;
+	float *fields;
+	capacity = capacity > MAX_SLOTS ? MAX_SLOTS : capacity;
+	// one allocation, the arrays follow the struct
+	s = calloc(1, sizeof *s + (9 + 2 * SLOT_TRAIL) * capacity * sizeof *fields);
+	fields = (float *)(s + 1);
+	s->capacity = capacity;
+	s->startx = fields;
+	s->starty = fields + capacity;
+	s->endx = fields + 2 * capacity;
+	s->endy = fields + 3 * capacity;
+	s->tstart = (uint32_t *)(fields + 4 * capacity);
+	s->tend = (uint32_t *)(fields + 5 * capacity);
+	s->trailn = (uint32_t *)(fields + 6 * capacity);
+	s->anchorx = fields + 7 * capacity;
+	s->anchory = fields + 8 * capacity;
+	s->trailx = fields + 9 * capacity;
+	s->traily = s->trailx + SLOT_TRAIL * capacity;
+	return s;
+}
+
+void slots_destroy(slots *s) {
+	free(s);
+}
+
+movement slot_movement(const slots *s, size_t i) {
+	return (movement){
+		.start = {s->startx[i], s->starty[i]},
+		.tstart = s->tstart[i],
+		.end = {s->endx[i], s->endy[i]},
+		.tend = s->tend[i],
+	};
+}
+
+size_t slot_trail(const slots *s, size_t i, float *x, float *y) {
+	size_t n = s->trailn[i], first = 0, k;
+	if (n > SLOT_TRAIL) {
+		first = n - SLOT_TRAIL;
+	}
+	for (size_t j = first; j < n; j++) {
+		k = i * SLOT_TRAIL + j % SLOT_TRAIL;
+		x[j - first] = s->trailx[k];
+		y[j - first] = s->traily[k];
+	}
+	return n - first;
+}
+
+slotmask get_ready_movements(slots *s) {
+	slotmask ready = s->ready;
+	s->ready = 0;
+	return ready;
+}
+
+size_t slotmask_pop(slotmask *mask) {
+	size_t i = __builtin_ctzll(*mask);
+	*mask &= *mask - 1;
+	return i;
+}
+
+bool any_down(const slots *s) {
+	return s->down != 0;
 }
@@ -1,13 +1,25 @@
 #ifndef LIBINPUT_TOUCHSCREEN_H
 #include "libinput-backend.h"
-#include "list.h"
+#include "shape.h"
+#include "zone.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #define LIBINPUT_TOUCHSCREEN_H
-#define MOV_SLOTS 10  // number of slots (eg maximum number of supported touch points
-#define MIN_EDGE_DISTANCE 10.0  // minimum gesture distance from edge (in mm)
+#define MOV_SLOTS 10  // slots of devices not reporting their touch count
+#define MAX_SLOTS 64  // most slots per device, one bit each in a slotmask
+#define SLOT_TRAIL 128  // path points kept per slot, older points are overwritten
+#define TRAIL_STEP 1.0f  // minimum distance in mm between recorded path points
+#define HOLD_SLOP 2.0f  // distance in mm a resting finger may drift
+#define HOLD_DEFAULT 800  // time in ms fingers rest before hold gestures fire
+#define EARLY_SETTLE 50  // time in ms the finger count holds before an early trigger
+#define PINCH_START 5.0f  // spread change in mm before a pinch starts
+#define ROTATE_START 10.0f  // rotation in degrees before a rotate starts
+#define CONTINUOUS_MIN 0.001f  // smallest pinch or rotate delta per frame
+#define MIN_EDGE_DISTANCE 10.0  // default minimum length in mm of border gestures
 #define DISPLAYCONF "dims.txt" // name of display configuration
 #define CONFIG_PATH "config"
+#define SEAT "seat0"  // udev seat whose touchscreens are used
 #define LOGGING false
 #ifndef M_PI
     #define M_PI 3.14159265358979323846
@@ -19,6 +31,11 @@ enum DIRECTION {  // if applied to borders, will just denote the side of the bor
 	DIR_RIGHT,  // movement towards right
 	DIR_BOT, // movement towards bottom
 	DIR_LEFT, // movement towards left
+	DIR_TOP_RIGHT,  // diagonals, only used when classifying 8 directions
+	DIR_BOT_RIGHT,
+	DIR_BOT_LEFT,
+	DIR_TOP_LEFT,
+	DIR_NUM,
 };
 
 enum GESTTYPE {
@@ -26,19 +43,62 @@ enum GESTTYPE {
 	GT_TAP,  // single tap on the screen with no movement
 	GT_MOVEMENT,  // general moving gesture
 	GT_BORDER,  // movement starting on border of screen
+	GT_HOLD,  // movement, then resting while still down
+	GT_LONGPRESS,  // resting since touching down, anchored to an edge or not
+	GT_PINCH,  // continuous change of the finger spread
+	GT_ROTATE,  // continuous rotation of the fingers
+	GT_SHAPE,  // path matching a template
 };
 
+// bit i set for movement slot i
+typedef uint64_t slotmask;
+
 typedef struct gesture {
 	enum GESTTYPE type;  // type of gesture
 	enum DIRECTION dir;  // direction of gesture
 	uint8_t num;  // multitouch number of fingers
+	uint8_t shape;  // template index of shape gestures
+	zonemask zones;  // zones all fingers started in
 } gesture;
 
 typedef struct rule {
-	gesture key;
+	gesture key;  // key.num is the lowest matching finger count
+	uint8_t maxnum;  // highest matching finger count
+	bool anydir;  // match gestures in all directions
+	int priority;  // higher priority wins if several rules match
+	float early;  // trigger once all fingers moved this far in mm, 0 waits for lift
+	float rate;  // most updates per second of continuous rules, 0 for the default
+	char app[64];  // application class the rule is limited to, empty for all
+	uint32_t timeout;  // kill command after timeout in ms, 0 for none
+	shape tmpl;  // template of shape rules
+	bool zoned;  // gesture has to start in area
+	uint8_t zone;  // index of area in the ruleset
+	zone area;
 	char command[512];
 } rule;
 
+enum TOUCHTYPE {
+	TT_DOWN,
+	TT_UP,
+	TT_MOTION,
+	TT_CANCEL,
+	TT_FRAME,
+};
+
+// single touch event independent of the input backend
+typedef struct touch_record {
+	uint64_t time;  // event time in microseconds
+	float x;  // position in mm
+	float y;
+	int32_t slot;
+	uint8_t type;  // enum TOUCHTYPE
+	uint8_t device;  // index of the touchscreen
+	uint8_t reserved[2];
+} touch_record;
+
+// Receiver of touch records converted from a backend stream
+typedef void (*record_handler)(const touch_record *t, void *data);
+
 typedef struct vec2 {
 	double x;
 	double y;
@@ -49,10 +109,27 @@ typedef struct movement {
 	uint32_t tstart;
 	vec2 end;
 	uint32_t tend;
-	bool ready;
-	bool down;
 } movement;
 
+// Touch state of all slots of a device, one array per field so that the
+// coordinates of a gesture share few cache lines. Flags are slot bitmasks.
+typedef struct slots {
+	size_t capacity;
+	float *startx, *starty, *endx, *endy;
+	uint32_t *tstart, *tend;
+	float *trailx, *traily;  // ring of SLOT_TRAIL path points per slot
+	uint32_t *trailn;  // number of path points recorded
+	float *anchorx, *anchory;  // position each finger rests at
+	uint64_t still;  // time in us since no finger moved, touched or lifted
+	uint32_t changed;  // time in ms a finger last touched or lifted
+	bool held;  // hold gestures were evaluated for this rest
+	slotmask down;
+	slotmask ready;  // lifted, waiting for gesture recognition
+	slotmask committed;  // gesture was triggered before lift
+	bool touched;  // a finger touched down since the sequence was last checked
+	bool pruned;  // no rule can match the current touch sequence
+} slots;
+
 // Print logging information
 void logger(const char *format, ...);
 
@@ -62,6 +139,13 @@ enum GESTTYPE str_to_gesttype(const char *s);
 enum DIRECTION str_to_direction(const char *s);
 // Radians angle to direction enum
 enum DIRECTION angle_to_direction(double angle);
+// Classify into 4 or 8 directions, movements up to deadzone mm have none
+void set_direction_mode(int directions, double deadzone);
+// Direction of a movement vector using comparisons only, agrees with
+// angle_to_direction(movement_angle()) in 4 direction mode
+enum DIRECTION vector_direction(float dx, float dy);
+// Classify n movement vectors in one pass
+void classify_directions(const float *dx, const float *dy, size_t n, uint8_t *dirs);
 
 // Calculate euclidean distance between two points
 double distance_euclidian(vec2 a, vec2 b);
@@ -76,6 +160,8 @@ double scalar_product(vec2 a, vec2 b);
 // Angle between two vectors in radians
 double vec2_angle(vec2 a, vec2 b);
 
+// Direction of movement end to movement start
+enum DIRECTION movement_vector_direction(const movement *m);
 // Angle of movement end to movement start in radians
 double movement_angle(const movement *m);
 // Euclidian distance between movement start and end
@@ -83,12 +169,30 @@ double movement_length(const movement *m);
 // Movement time difference start end
 uint32_t movement_timedelta(const movement *m);
 
-/* Movement Array functions */
-// Get a indices of all ready movements
-list *get_ready_movements(movement *m);
-// Check whether any movement struct pressed down
-bool any_down(movement *m);
+/* Slot store functions */
+// Allocate touch state for capacity slots, at most MAX_SLOTS
+slots *slots_new(size_t capacity);
+// Free touch state
+void slots_destroy(slots *s);
+// Copy of a single slot as movement
+movement slot_movement(const slots *s, size_t i);
+// Copy the recorded path of a slot oldest first, returns the number of points
+size_t slot_trail(const slots *s, size_t i, float *x, float *y);
+// Get mask of all ready movements and clear their ready flags
+slotmask get_ready_movements(slots *s);
+// Index of lowest slot in mask, which is then removed from the mask
+size_t slotmask_pop(slotmask *mask);
+// Check whether any finger is down
+bool any_down(const slots *s);
 
-// Fill movements with libinput events
-void handle_event(struct libinput_event *event, movement *m);
+// Convert libinput touch event into a touch record, false for other events
+bool touch_from_event(struct libinput_event *event, touch_record *t);
+// Fill slots with a touch record, slot -1 of single touch devices is slot 0
+// and slots beyond the capacity are dropped. Motion of pruned sequences is
+// only counted.
+void handle_touch(const touch_record *t, slots *s);
+// Fill slots with a touch record of any backend, tracing and capturing it
+void handle_record(const touch_record *t, slots *s);
+// Fill slots of device index with libinput events
+void handle_event(struct libinput_event *event, slots *s, uint8_t device);
 #endif
@@ -26,8 +26,12 @@ list *list_new(const void *first_val, size_t size) {
 }
 
 list *list_append(list *l, const void *newval, size_t size) {
-	l->tail->next = calloc(1, sizeof(node));
-	l->tail = l->tail->next;
+	if (l->tail == NULL) {
+		l->head = l->tail = calloc(1, sizeof(node));
+	} else {
+		l->tail->next = calloc(1, sizeof(node));
+		l->tail = l->tail->next;
+	}
 	l->tail->value = malloc(size);
 	l->tail->size = size;
 	memcpy(l->tail->value, newval, size);
@@ -18,7 +18,7 @@ typedef struct list {
 void list_destroy(list *list);
 // Create a new list with a first initial value and size copied into the list
 list *list_new(const void *first_val, size_t size);
-// Append a value, will be copied into the list
+// Append a value, will be copied into the list, which may be empty
 list *list_append(list *l, const void *newval, size_t size);
 // Print list items
 void list_print(list *l);
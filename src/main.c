@@ -1,9 +1,25 @@
 #include "libinput-touchscreen.h"
-#include "calibration.h"
+#include "action.h"
+#include "backend.h"
+#include "bus.h"
+#include "capture.h"
 #include "configuration.h"
+#include "control.h"
+#include "executor.h"
+#include "focus.h"
+#include "gesture.h"
 #include "list.h"
+#include "realtime.h"
+#include "reload.h"
+#include "ruleset.h"
+#include "scheduler.h"
+#include "touchdevice.h"
+#include "trace.h"
+#include "update.h"
 
 #include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
 #include <wordexp.h>
 
 #include <errno.h>
@@ -17,162 +33,296 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-void print_timedelta(uint32_t timedelta) {
-	printf("Time %ds\n", timedelta);
-}
+static const char *stats_path = NULL;  // file periodically receiving latency stats
+static const char *control_path = NULL;  // control socket, none if NULL
+static bool pipelined = false;  // read input on its own thread
+static int rtpriority = 0;  // SCHED_FIFO priority of the event loop, 0 for normal scheduling
+static int rtcpu = -1;  // CPU the event loop is pinned to, -1 for none
 
-void print_gesture(gesture *g) {
-	printf("G(%d) T%d D%d\n", g->num, g->type, g->dir);
+void trigger_rules(gesture *g, const ruleset *rules) {
+	const rule *r = ruleset_match(rules, g);
+	if (r != NULL) {
+		trace_stage(TRACE_MATCH);
+		printf("Trigger %s\n", r->command);
+		ruleset_hit(rules, r);
+		if (action_run(r->command, r->timeout) == 0) {
+			trace_stage(TRACE_SPAWN);
+		}
+	}
 }
 
-int argmax(const size_t *arr, size_t len) {
-	size_t highest = 0;
-	int index = 0;
-	for (size_t i = 0; i < len; i++) {
-		if (arr[i] > highest) {
-			highest = arr[i];
-			index = i;
-		} else if (arr[i] == highest) {
-			index = -1;
-		}
+// Recognize gestures before or after lift and trigger their rules
+void handle_gestures(slots *s, movement *screen, const ruleset *rules) {
+	gesture g;
+	if (handle_streaming(s, screen, rules, &g)) {
+		trace_commit();
+	} else if (!handle_movements(s, screen, rules, &g)) {
+		return;
 	}
-	return index;
+	trace_stage(TRACE_CLASSIFY);
+	print_gesture(&g);
+	trigger_rules(&g, rules);
 }
 
-enum DIRECTION movement_direction(movement *m, list *ready) {
-	enum DIRECTION dir = 0;
-	size_t enum_votes[5] = {0}, i = 0;
-	// collect individually transformed directions
-	node *cur = ready->head;
-	while (cur != NULL) {
-		i = *((size_t *)cur->value);
-		enum_votes[angle_to_direction(movement_angle(m + i))]++;
-		cur = cur->next;
-	}
-	// check if multiple directions had the same maximum vote
-	if ((dir = argmax(enum_votes, 5)) < 0) {
-		dir = DIR_NONE;
-	}
-	return dir;
+// Evaluate gestures of a touchscreen whose touch frame completed
+void handle_frame(touch_device *d, void *data) {
+	const ruleset *rules = data;
+	if (prune_sequence(d->touches, &d->screen, rules)) {
+		return;
+	}
+	handle_gestures(d->touches, &d->screen, rules);
+	handle_continuous(d->touches, rules, &d->cont, sched_now());
 }
 
-enum DIRECTION movement_border_direction(movement *m, list *ready, movement *screen) {
-	movement *cm;
-	vec2 startvec;
-	node *cur = ready->head;
-	logger("Movement border dir: start\n");
-	while (cur != NULL) {
-		cm = (m + *((size_t *)cur->value));
-		startvec = cm->start;
-		if (movement_length(cm) >= MIN_EDGE_DISTANCE) {
-			if (startvec.x <= screen->start.x) {
-				return DIR_LEFT;
-			}
-			if (startvec.x >= screen->end.x) {
-				return DIR_RIGHT;
-			}
-			if (startvec.y <= screen->start.y) {
-				return DIR_TOP;
-			}
-			if (startvec.y >= screen->end.y) {
-				return DIR_BOT;
-			}
-		}
-		cur = cur->next;
+// Launch the continuous updates due now
+void send_updates(const ruleset *rules) {
+	char command[sizeof ((rule *)0)->command + 32];
+	const rule *r;
+	double delta;
+	while (update_next(sched_now(), &r, &delta)) {
+		update_command(command, sizeof command, r->command, delta);
+		printf("Update %s\n", command);
+		ruleset_hit(rules, r);
+		action_run(command, r->timeout);
 	}
-	logger("Movement border dir: end\n");
-	return DIR_NONE;
 }
 
-gesture get_gesture(movement *m, movement *screen, list *ready) {
-	logger("Get gesture: begin\n");
-	gesture g = {0};
-	g.num = list_len(ready);
-	logger("Get gesture: list len %d\n", g.num);
-	g.dir = movement_direction(m, ready);
-	enum DIRECTION border_dir;
-	logger("Get gesture: got dir\n");
-	if (g.dir == DIR_NONE) {
-		g.type = GT_TAP;
-	} else if (g.num > 1) {
-		g.type = GT_MOVEMENT;
-	} else if ((border_dir = movement_border_direction(m, ready, screen)) != DIR_NONE) {
-		g.type = GT_BORDER;
-		g.dir = border_dir;
-	}
-	logger("Get gesture: end\n");
-	return g;
+// Block signals handled in the poll loop and return a signalfd receiving them
+int create_signalfd(sigset_t *origmask) {
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGUSR1);
+	if (sigprocmask(SIG_BLOCK, &mask, origmask) == -1) {
+		printf("Failed to block signals: %s\n", strerror(errno));
+		return -1;
+	}
+	return signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
 }
 
-void trigger_rules(gesture *g, list *rules) {
-	node *cur = rules->head;
-	rule *r;
-	while (cur != NULL) {
-		r = (rule *)cur->value;
-		if ((g->dir == r->key.dir)&&(g->type == r->key.type)&&(g->num == r->key.num)){
-			printf("Trigger %s\n", r->command);
-			system(r->command);
-			return;
+void handle_signals(int sfd) {
+	struct signalfd_siginfo info;
+	while (read(sfd, &info, sizeof info) == sizeof info) {
+		switch (info.ssi_signo) {
+		case SIGCHLD:
+			executor_reap();
+			break;
+		case SIGUSR1:
+			trace_dump(stdout);
+			fflush(stdout);
+			break;
+		default:
+			break;
 		}
-		cur = cur->next;
 	}
 }
 
-void handle_movements(movement *m, movement *screen, list *rules) {
-	// skip if some fingers are still on the screen
-	if (any_down(m)) {
-		logger("SKIP handle movements: any down\n");
+enum TIMERS {
+	TIMER_EXECUTOR,  // next command timeout
+	TIMER_STATS,  // next stats file write
+	TIMER_UPDATE,  // next rate limited continuous update
+	TIMER_CALIBRATION,  // next write of learned calibrations
+	TIMER_BUS,  // next attempt to reopen the session bus connection
+	TIMER_HOLD,  // resting fingers, one timer per touchscreen
+	TIMER_NUM = TIMER_HOLD + MAX_DEVICES,
+};
+
+// Write stats file and schedule the next write
+void write_stats(void) {
+	if (stats_path == NULL) {
 		return;
 	}
-	list *ready = get_ready_movements(m);
-	if (ready == NULL) {
-		logger("SKIP handle movements: none ready\n");
+	trace_write(stats_path);
+	sched_set(TIMER_STATS, sched_now() + TRACE_INTERVAL * 1000);
+}
+
+// Fire hold gestures of a touchscreen whose fingers rested long enough
+void handle_hold_timer(touch_device *d, const ruleset *rules, uint64_t now) {
+	uint64_t deadline = hold_deadline(d->touches, rules);
+	gesture g;
+	if (!handle_hold(d->touches, &d->screen, rules, now, &g)) {
 		return;
 	}
-	logger("Handle movements: begin\n");
-	gesture g = get_gesture(m, screen, ready);
-	logger("Handle movements: got gesture\n");
+	trace_deadline(deadline);
+	trace_stage(TRACE_CLASSIFY);
 	print_gesture(&g);
-
 	trigger_rules(&g, rules);
+}
+
+void handle_timers(const ruleset *rules) {
+	uint64_t now = sched_now();
+	touch_device *d;
+	int id;
+	while ((id = sched_expired(now)) >= 0) {
+		switch (id) {
+		case TIMER_EXECUTOR:
+			executor_expire();
+			break;
+		case TIMER_STATS:
+			write_stats();
+			break;
+		case TIMER_UPDATE:
+			send_updates(rules);
+			break;
+		case TIMER_CALIBRATION:
+			devices_save(now);
+			break;
+		case TIMER_BUS:
+			bus_retry(now);
+			break;
+		default:
+			if ((d = device_get(id - TIMER_HOLD)) != NULL) {
+				handle_hold_timer(d, rules, now);
+			}
+			break;
+		}
+	}
+}
 
-	list_destroy(ready);
-	logger("Handle movements: end\n");
+// Set all deadlines from the current state, nothing is armed while idle
+void schedule_timers(const ruleset *rules) {
+	touch_device *d;
+	sched_set(TIMER_EXECUTOR, executor_expire());
+	sched_set(TIMER_UPDATE, update_deadline());
+	sched_set(TIMER_CALIBRATION, devices_save_deadline());
+	sched_set(TIMER_BUS, bus_deadline());
+	for (size_t i = 0; i < MAX_DEVICES; i++) {
+		d = device_get(i);
+		sched_set(TIMER_HOLD + i, d ? hold_deadline(d->touches, rules) : SCHED_NONE);
+	}
+	sched_arm();
 }
 
-void get_movements(struct libinput *li, struct movement *screen, list *rules) {
-	// movements have pointer structs inside
-	struct movement movements[10] = {{{0}}};
-	struct libinput_event *event;
-	struct pollfd fds;
-	fds.fd = libinput_get_fd(li);
-	fds.events = POLLIN;
-	fds.revents = 0;
+enum POLLFDS {
+	FD_INPUT,  // touch events of the backend
+	FD_SIGNAL,  // exited commands and stats requests
+	FD_WATCH,  // config file changes
+	FD_RELOAD,  // reparsed config ready
+	FD_FOCUS,  // X server, for active window changes
+	FD_TIMER,  // scheduler deadlines
+	FD_BUS,  // session bus connection
+	FD_CONTROL,  // control socket and its clients
+	FD_NUM = FD_CONTROL + CONTROL_FDS,
+};
 
-	while (poll(&fds, 1, -1) > -1) {
+// Swap in reloaded rules between gestures, false while fingers are down
+bool swap_rules(ruleset **rules, const sigset_t *origmask) {
+	settings s;
+	ruleset *new;
+	if (devices_any_down()) {
+		return false;
+	}
+	if ((new = reload_take(&s)) != NULL) {
+		// pending updates point into the old rules
+		update_clear();
+		ruleset_destroy(*rules);
+		*rules = new;
+		control_rules_changed();
+		ruleset_activate(new, focus_class(), focus_instance());
+		action_prepare(new);
+		executor_init(s.max_children, origmask);
+		set_direction_mode(s.directions, s.deadzone);
+		set_hold_time(s.hold);
+		set_edge_distance(s.edge);
+	}
+	return true;
+}
+
+void get_movements(backend *b, ruleset **rules, int sfd, int wfd, const sigset_t *origmask) {
+	bool reloaded = false;
+	size_t events;
+	struct pollfd fds[FD_NUM] = {
+		[FD_INPUT] = {.fd = b->fd(b), .events = POLLIN},
+		[FD_SIGNAL] = {.fd = sfd, .events = POLLIN},
+		[FD_WATCH] = {.fd = wfd, .events = POLLIN},
+		[FD_RELOAD] = {.fd = reload_result_fd(), .events = POLLIN},
+		[FD_FOCUS] = {.fd = focus_fd(), .events = POLLIN},
+		[FD_TIMER] = {.fd = sched_fd(), .events = POLLIN},
+		[FD_BUS] = {.fd = bus_fd(), .events = bus_events()},
+	};
+
+	write_stats();
+	schedule_timers(*rules);
+	// devices only change while waiting for input
+	devices_lock();
+	for (;;) {
+		// the connection may be opened or lost between cycles
+		fds[FD_INPUT].fd = b->fd(b);
+		fds[FD_BUS].fd = bus_fd();
+		fds[FD_BUS].events = bus_events();
+		control_pollfds(fds + FD_CONTROL);
+		devices_unlock();
+		if (poll(fds, FD_NUM, -1) == -1) {
+			break;
+		}
+		devices_lock();
 		logger("Start poll cycle\n");
-		libinput_dispatch(li);
-		while ((event = libinput_get_event(li)) != NULL) {
-			// handle the event here
-			handle_event(event, movements);
-			libinput_event_destroy(event);
-			libinput_dispatch(li);
+		if (fds[FD_SIGNAL].revents & POLLIN) {
+			handle_signals(sfd);
+		}
+		if (fds[FD_WATCH].revents & POLLIN) {
+			reload_handle_watch();
+		}
+		if (fds[FD_RELOAD].revents & POLLIN) {
+			reloaded = reload_handle_result();
+		}
+		if (fds[FD_FOCUS].revents && focus_handle()) {
+			ruleset_activate(*rules, focus_class(), focus_instance());
+			fds[FD_FOCUS].fd = focus_fd();
 		}
-		handle_movements(movements, screen, rules);
+		if (fds[FD_TIMER].revents & POLLIN) {
+			handle_timers(*rules);
+		}
+		if (fds[FD_BUS].revents) {
+			bus_handle();
+		}
+		control_handle(fds + FD_CONTROL, *rules, handle_frame);
+		// events of a new gesture are only handled after this
+		if (reloaded) {
+			reloaded = !swap_rules(rules, origmask);
+		}
+		if (!fds[FD_INPUT].revents) {
+			trace_wakeup(0);
+			schedule_timers(*rules);
+			continue;
+		}
+		// gestures only change when a touch frame completes
+		events = b->dispatch(b, handle_frame, *rules);
+		trace_wakeup(events);
+		capture_flush();
+		send_updates(*rules);
+		schedule_timers(*rules);
 		logger("End poll cycle\n");
 	}
 }
 
-int get_device_event_loop(const char *devpath, const char *rulespath, const char *calibpath) {
-	struct movement screen;
-	if (access(calibpath, F_OK) != -1) {
-		screen = read_screen_dimensions(calibpath);
-	} else {
-		screen = calibrate_touchscreen(devpath, calibpath);
-	}
-
+int get_seat_event_loop(const char *seat, const char *evdev, const char *rulespath) {
 	// load rules
-	list *rules = load_rules(rulespath);
+	settings s = {.max_children = EXEC_DEFAULT_CHILDREN};
+	list *rulelist = load_rules(rulespath, &s);
+	if (rulelist == NULL) {
+		return -1;
+	}
+	ruleset *rules = ruleset_compile(rulelist);
+	list_destroy(rulelist);
+	sigset_t origmask;
+	int sfd = create_signalfd(&origmask);
+	if (sfd == -1) {
+		return -1;
+	}
+	executor_init(s.max_children, &origmask);
+	action_prepare(rules);
+	set_direction_mode(s.directions, s.deadzone);
+	set_hold_time(s.hold);
+	set_edge_distance(s.edge);
+	if (sched_init() == -1) {
+		return -1;
+	}
+	int wfd = reload_init(rulespath);
+	focus_init();
+	if (control_path != NULL && !control_init(control_path)) {
+		return -1;
+	}
 
 	// node *cur = rules->head;
 	// while (cur != NULL) {
@@ -182,45 +332,86 @@ int get_device_event_loop(const char *devpath, const char *rulespath, const char
 	// }
 	// return 0;
 
-	struct libinput *li = create_libinput_device_interface(devpath);
-	if (li == NULL) {
+	// an ingestion thread of the backend takes the priority, not the CPU
+	if (rtpriority > 0) {
+		realtime_start(rtpriority, rtcpu);
+	}
+	// libinput touchscreens are set up from the initial device added events
+	backend *b = evdev ? evdev_backend_new(evdev) : libinput_backend_new(seat);
+	if (b != NULL && pipelined) {
+		b = pipeline_backend_new(b);
+	}
+	if (b == NULL) {
 		return -1;
 	}
-	clear_event_pipe(li);
+	printf("Reading touches through %s\n", b->name);
 
-	get_movements(li, &screen, rules);
+	get_movements(b, &rules, sfd, wfd, &origmask);
 
-	list_destroy(rules);
-	libinput_unref(li);
+	close(sfd);
+	sched_destroy();
+	focus_destroy();
+	control_destroy();
+	action_close();
+	ruleset_destroy(rules);
+	b->destroy(b);
 	return 0;
 }
 
-#define PROGNAME "libinput-touchscreen"
-
-char *get_conf_path(const char *filename) {
-	const char *config_frag = "/.config/";
-	char *homedir = getenv("HOME");
-	size_t lconfdir = strlen(homedir) + strlen(config_frag) + strlen(PROGNAME) + 1 + strlen(filename) + 1;
-	char *confdir = calloc(lconfdir, sizeof *confdir);
-	memcpy(confdir, homedir, strlen(homedir));
-	strncat(confdir, config_frag, lconfdir);
-	strncat(confdir, PROGNAME, lconfdir);
-	strncat(confdir, "/", lconfdir);
-	strncat(confdir, filename, lconfdir);
-	return confdir;
+void usage(const char *name) {
+	printf("Usage: %s [-c SOCKET] [-e DEVICE] [-i] [-p] [-r CAPTURE] [-R PRIORITY[,CPU]] [-s STATS]\n", name);
+	printf("  -c SOCKET   accept control commands on unix socket SOCKET\n");
+	printf("  -e DEVICE   read multitouch events of DEVICE directly instead of libinput\n");
+	printf("  -i          calibrate uncalibrated touchscreens of unknown size by hand\n");
+	printf("  -p          read input on its own thread, queued to the recognizer\n");
+	printf("  -r CAPTURE  record all touch events into CAPTURE\n");
+	printf("  -R PRIO,CPU lock memory and run the event loop at SCHED_FIFO priority PRIO,\n");
+	printf("              pinned to CPU if given\n");
+	printf("  -s STATS    periodically write latency stats to STATS\n");
+	printf("Latency stats are printed on SIGUSR1.\n");
 }
 
-
-int main(void) {
-	char *devpath = find_touch_device();
-	printf("Device found: %s\n", devpath);
+int main(int argc, char **argv) {
+	const char *evdev = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:e:ipr:R:s:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			control_path = optarg;
+			break;
+		case 'e':
+			evdev = optarg;
+			break;
+		case 'i':
+			device_calibrate_interactively(true);
+			break;
+		case 'p':
+			pipelined = true;
+			break;
+		case 'r':
+			if (!capture_start(optarg)) {
+				return 1;
+			}
+			break;
+		case 'R':
+			if (sscanf(optarg, "%d,%d", &rtpriority, &rtcpu) < 1) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 's':
+			stats_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
 
 	char *config = get_conf_path(CONFIG_PATH);
-	char *display = get_conf_path(DISPLAYCONF);
 
-	get_device_event_loop(devpath, config, display);
-	free(devpath);
+	get_seat_event_loop(SEAT, evdev, config);
 	free(config);
-	free(display);
+	capture_stop();
 	return 0;
 }
@@ -0,0 +1,195 @@
+#include "pipeline.h"
+#include "backend.h"
+#include "realtime.h"
+#include "trace.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+bool ring_push(ring *r, const touch_record *t) {
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	if (tail - r->head_cache == PIPELINE_RING) {
+		r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+		if (tail - r->head_cache == PIPELINE_RING) {
+			return false;
+		}
+	}
+	r->records[tail & (PIPELINE_RING - 1)] = *t;
+	atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+	return true;
+}
+
+bool ring_pop(ring *r, touch_record *t) {
+	size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	if (head == r->tail_cache) {
+		r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+		if (head == r->tail_cache) {
+			return false;
+		}
+	}
+	*t = r->records[head & (PIPELINE_RING - 1)];
+	atomic_store_explicit(&r->head, head + 1, memory_order_release);
+	return true;
+}
+
+size_t ring_fill(ring *r) {
+	return atomic_load_explicit(&r->tail, memory_order_acquire) -
+	       atomic_load_explicit(&r->head, memory_order_acquire);
+}
+
+// The ingestion thread only drains the inner backend into the ring and
+// wakes the recognizer through an eventfd, which the recognizer polls
+// instead of the input. Motion is dropped when the ring is full, the next
+// motion of the slot has the newer position. All other records wait for
+// space, so no finger is lost.
+typedef struct pipeline_backend {
+	backend b;
+	backend *inner;
+	ring *queue;
+	int wake;  // eventfd readable when records were queued
+	int stop;  // eventfd telling the ingestion thread to exit
+	pthread_t thread;
+} pipeline_backend;
+
+static void pipeline_wake(pipeline_backend *pb) {
+	uint64_t one = 1;
+	write(pb->wake, &one, sizeof one);
+}
+
+static void pipeline_sleep(void) {
+	struct timespec ts = {.tv_nsec = PIPELINE_WAIT * 1000};
+	nanosleep(&ts, NULL);
+}
+
+static void pipeline_record(const touch_record *t, void *data) {
+	pipeline_backend *pb = data;
+	if (ring_push(pb->queue, t)) {
+		return;
+	}
+	trace_ring_fill(PIPELINE_RING);
+	pipeline_wake(pb);
+	if (t->type == TT_MOTION) {
+		trace_overflow();
+		return;
+	}
+	trace_backpressure();
+	while (!ring_push(pb->queue, t)) {
+		pipeline_sleep();
+	}
+}
+
+// devices change only after the recognizer handled all queued records
+static void pipeline_lock(void *data) {
+	pipeline_backend *pb = data;
+	pipeline_wake(pb);
+	while (ring_fill(pb->queue) > 0) {
+		pipeline_sleep();
+	}
+	devices_lock();
+}
+
+static void pipeline_unlock(void *data) {
+	devices_unlock();
+}
+
+static void *pipeline_ingest(void *arg) {
+	pipeline_backend *pb = arg;
+	record_sink sink = {pipeline_record, pipeline_lock, pipeline_unlock, pb};
+	struct pollfd fds[2] = {
+		{.fd = pb->stop, .events = POLLIN},
+		{.events = POLLIN},
+	};
+	// a pinned recognizer keeps its CPU to itself
+	realtime_elsewhere();
+	for (;;) {
+		// the fd of a removed evdev device is -1 and ignored
+		fds[1].fd = pb->inner->fd(pb->inner);
+		if (poll(fds, 2, -1) == -1 || fds[0].revents) {
+			break;
+		}
+		if (fds[1].revents && pb->inner->drain(pb->inner, &sink) > 0) {
+			trace_ring_fill(ring_fill(pb->queue));
+			pipeline_wake(pb);
+		}
+	}
+	return NULL;
+}
+
+static int pipeline_backend_fd(backend *b) {
+	return ((pipeline_backend *)b)->wake;
+}
+
+static size_t pipeline_backend_dispatch(backend *b, frame_handler frame, void *data) {
+	pipeline_backend *pb = (pipeline_backend *)b;
+	touch_record t;
+	touch_device *d;
+	size_t events = 0;
+	uint64_t n;
+	// records queued after this are announced again
+	read(pb->wake, &n, sizeof n);
+	while (ring_pop(pb->queue, &t)) {
+		events++;
+		if ((d = device_get(t.device)) == NULL) {
+			continue;
+		}
+		device_record(d, &t);
+		if (t.type == TT_FRAME) {
+			frame(d, data);
+		}
+	}
+	return events;
+}
+
+static void pipeline_backend_destroy(backend *b) {
+	pipeline_backend *pb = (pipeline_backend *)b;
+	uint64_t one = 1;
+	write(pb->stop, &one, sizeof one);
+	pthread_join(pb->thread, NULL);
+	pb->inner->destroy(pb->inner);
+	close(pb->wake);
+	close(pb->stop);
+	free(pb->queue);
+	free(pb);
+}
+
+backend *pipeline_backend_new(backend *inner) {
+	pipeline_backend *pb;
+	if (inner->drain == NULL) {
+		printf("The %s backend cannot be read on its own thread\n", inner->name);
+		inner->destroy(inner);
+		return NULL;
+	}
+	pb = calloc(1, sizeof *pb);
+	pb->b = (backend){
+		.name = "pipeline",
+		.fd = pipeline_backend_fd,
+		.dispatch = pipeline_backend_dispatch,
+		.destroy = pipeline_backend_destroy,
+	};
+	pb->inner = inner;
+	pb->queue = aligned_alloc(alignof(ring), sizeof *pb->queue);
+	atomic_init(&pb->queue->head, 0);
+	atomic_init(&pb->queue->tail, 0);
+	pb->queue->head_cache = pb->queue->tail_cache = 0;
+	pb->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	pb->stop = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (pb->wake == -1 || pb->stop == -1 || pthread_create(&pb->thread, NULL, pipeline_ingest, pb) != 0) {
+		printf("Failed to start the ingestion thread\n");
+		if (pb->wake != -1) {
+			close(pb->wake);
+		}
+		if (pb->stop != -1) {
+			close(pb->stop);
+		}
+		free(pb->queue);
+		free(pb);
+		inner->destroy(inner);
+		return NULL;
+	}
+	return &pb->b;
+}
@@ -0,0 +1,29 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include "libinput-touchscreen.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#define PIPELINE_RING 4096  // touch records queued between the threads, a power of two
+#define PIPELINE_WAIT 100  // us the ingestion thread sleeps while waiting for the recognizer
+
+// Lock-free queue of touch records from a single producer thread to a
+// single consumer thread. Head and tail only grow and live on their own
+// cache lines, each side caches the index of the other to touch the shared
+// line only when its cached view runs out.
+typedef struct ring {
+	alignas(64) _Atomic size_t tail;  // next record written by the producer
+	size_t head_cache;  // producer view of head
+	alignas(64) _Atomic size_t head;  // next record read by the consumer
+	size_t tail_cache;  // consumer view of tail
+	alignas(64) touch_record records[PIPELINE_RING];
+} ring;
+
+// Queue a record, false if the ring is full
+bool ring_push(ring *r, const touch_record *t);
+// Take the oldest record, false if the ring is empty
+bool ring_pop(ring *r, touch_record *t);
+// Number of queued records, exact only on the consumer thread
+size_t ring_fill(ring *r);
+#endif
@@ -0,0 +1,130 @@
+// cpu_set_t and SCHED_RESET_ON_FORK are GNU extensions
+#define _GNU_SOURCE
+#include "realtime.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static bool active = false;
+static bool pinned = false;
+static cpu_set_t allcpus;  // affinity the daemon started with
+static cpu_set_t rtcpus;  // affinity of the event loop
+static struct sched_param rtparam;  // priority of the event loop
+
+// touch stack pages the event loop may grow into later
+static void prefault_stack(void) {
+	volatile char stack[REALTIME_STACK];
+	for (size_t i = 0; i < sizeof stack; i += 4096) {
+		stack[i] = 0;
+	}
+}
+
+// keep freed heap mapped and touch it, so later allocations do not fault
+static void prefault_heap(void) {
+	char *heap;
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+	if ((heap = malloc(REALTIME_HEAP)) != NULL) {
+		memset(heap, 0, REALTIME_HEAP);
+		free(heap);
+	}
+}
+
+// lock all memory, memory mapped later only if the lock limit allows it
+static void lock_memory(void) {
+	struct rlimit rl;
+	int flags = MCL_CURRENT;
+	getrlimit(RLIMIT_MEMLOCK, &rl);
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_MEMLOCK, &rl);
+	// thread stacks would fail to map once the limit is reached
+	if (rl.rlim_cur == RLIM_INFINITY || geteuid() == 0) {
+		flags |= MCL_FUTURE;
+	}
+	if (mlockall(flags) == -1) {
+		printf("Failed to lock memory: %s\n", strerror(errno));
+		return;
+	}
+	if (!(flags & MCL_FUTURE)) {
+		printf("Memory lock limit too low, only memory mapped so far is locked\n");
+	}
+	prefault_stack();
+	prefault_heap();
+}
+
+void realtime_start(int priority, int cpu) {
+	struct sched_param param = {.sched_priority = priority};
+	int min = sched_get_priority_min(SCHED_FIFO), max = sched_get_priority_max(SCHED_FIFO);
+	lock_memory();
+	// children fall back to normal priority when forked
+	if (priority < min || priority > max) {
+		printf("Real-time priority must be between %d and %d\n", min, max);
+	} else if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) == -1) {
+		printf("Failed to set real-time priority %d: %s\n", priority, strerror(errno));
+	} else {
+		active = true;
+		rtparam = param;
+	}
+	if (cpu < 0) {
+		return;
+	}
+	sched_getaffinity(0, sizeof allcpus, &allcpus);
+	CPU_ZERO(&rtcpus);
+	CPU_SET(cpu, &rtcpus);
+	if (sched_setaffinity(0, sizeof rtcpus, &rtcpus) == -1) {
+		printf("Failed to pin to CPU %d: %s\n", cpu, strerror(errno));
+		return;
+	}
+	pinned = true;
+}
+
+bool realtime_active(void) {
+	return active;
+}
+
+void realtime_unpin(void) {
+	if (pinned) {
+		sched_setaffinity(0, sizeof allcpus, &allcpus);
+	}
+}
+
+void realtime_pin(void) {
+	if (pinned) {
+		sched_setaffinity(0, sizeof rtcpus, &rtcpus);
+	}
+}
+
+void realtime_background(void) {
+	struct sched_param param = {0};
+	if (active) {
+		pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+	}
+	realtime_unpin();
+}
+
+void realtime_elsewhere(void) {
+	cpu_set_t cpus;
+	// threads start at normal priority because of SCHED_RESET_ON_FORK
+	if (active) {
+		pthread_setschedparam(pthread_self(), SCHED_FIFO, &rtparam);
+	}
+	if (!pinned) {
+		return;
+	}
+	// the CPUs the daemon started with, except the one of the event loop
+	CPU_XOR(&cpus, &allcpus, &rtcpus);
+	CPU_AND(&cpus, &cpus, &allcpus);
+	if (CPU_COUNT(&cpus) == 0) {
+		printf("No other CPU, the ingestion thread shares the one of the event loop\n");
+		return;
+	}
+	sched_setaffinity(0, sizeof cpus, &cpus);
+}
@@ -0,0 +1,29 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+#include <stdbool.h>
+#define REALTIME_STACK (512 * 1024)  // bytes of stack touched in advance
+#define REALTIME_HEAP (4 * 1024 * 1024)  // bytes of heap touched in advance
+
+// Real-time mode for the thread running the event loop. Memory is locked
+// and touched in advance so handling input never page faults, the thread
+// runs under SCHED_FIFO and optionally on a single CPU. Commands and
+// background threads run at normal priority on all CPUs. Every step that
+// lacks permission is skipped with a message.
+
+// Lock memory, run the calling thread at SCHED_FIFO priority (1-99) and
+// pin it to cpu, -1 for all CPUs
+void realtime_start(int priority, int cpu);
+// Whether the calling thread got real-time priority
+bool realtime_active(void);
+// Let the calling thread run on all CPUs again, so that commands spawned
+// before realtime_pin are not pinned
+void realtime_unpin(void);
+// Pin the calling thread again after realtime_unpin
+void realtime_pin(void);
+// Run the calling thread at normal priority on all CPUs, for threads doing
+// background work
+void realtime_background(void);
+// Run the calling thread at the priority of the event loop but off its CPU,
+// for threads feeding it input, which do not inherit the priority
+void realtime_elsewhere(void);
+#endif
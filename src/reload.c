@@ -0,0 +1,131 @@
+#include "reload.h"
+#include "executor.h"
+#include "realtime.h"
+
+#include <errno.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static char *confpath;
+static char *confname;
+static int ifd = -1;
+static int efd = -1;
+
+// state shared with the worker, which owns it while running is set
+static bool running = false;
+static bool dirty = false;  // config changed again while parsing
+static ruleset *parsed = NULL;
+static settings parsed_settings;
+
+static void *reload_worker(void *arg) {
+	uint64_t done = 1;
+	list *rulelist;
+	realtime_background();
+	parsed_settings = (settings){.max_children = EXEC_DEFAULT_CHILDREN};
+	rulelist = load_rules(confpath, &parsed_settings);
+	if (rulelist != NULL) {
+		parsed = ruleset_compile(rulelist);
+		list_destroy(rulelist);
+	}
+	write(efd, &done, sizeof done);
+	return NULL;
+}
+
+static void reload_start(void) {
+	pthread_t thread;
+	if (running) {
+		dirty = true;
+		return;
+	}
+	// a parsed but not yet taken config is outdated now
+	if (parsed != NULL) {
+		ruleset_destroy(parsed);
+		parsed = NULL;
+	}
+	running = true;
+	dirty = false;
+	if (pthread_create(&thread, NULL, reload_worker, NULL) != 0) {
+		printf("Failed to start config reload\n");
+		running = false;
+		return;
+	}
+	pthread_detach(thread);
+}
+
+int reload_init(const char *path) {
+	char *dir = strdup(path);
+	confpath = strdup(path);
+	confname = basename(confpath);
+	ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	// editors often replace the file, so watch the directory
+	if (ifd == -1 || efd == -1 ||
+	    inotify_add_watch(ifd, dirname(dir), IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+		printf("Failed to watch config %s: %s\n", path, strerror(errno));
+		free(dir);
+		return -1;
+	}
+	free(dir);
+	return ifd;
+}
+
+int reload_result_fd(void) {
+	return efd;
+}
+
+void reload_handle_watch(void) {
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	bool changed = false;
+	ssize_t len;
+	while ((len = read(ifd, buf, sizeof buf)) > 0) {
+		for (char *p = buf; p < buf + len; p += sizeof *ev + ev->len) {
+			ev = (const struct inotify_event *)p;
+			if (ev->len > 0 && strcmp(ev->name, confname) == 0) {
+				changed = true;
+			}
+		}
+	}
+	if (changed) {
+		printf("Config changed, reloading\n");
+		reload_start();
+	}
+}
+
+bool reload_handle_result(void) {
+	uint64_t done;
+	if (read(efd, &done, sizeof done) != sizeof done) {
+		return parsed != NULL;
+	}
+	running = false;
+	if (dirty) {
+		// result is outdated already
+		if (parsed != NULL) {
+			ruleset_destroy(parsed);
+			parsed = NULL;
+		}
+		reload_start();
+		return false;
+	}
+	if (parsed == NULL) {
+		printf("Config invalid, keeping previous rules\n");
+	}
+	return parsed != NULL;
+}
+
+ruleset *reload_take(settings *s) {
+	ruleset *rs = parsed;
+	if (rs == NULL || running) {
+		return NULL;
+	}
+	*s = parsed_settings;
+	parsed = NULL;
+	printf("Loaded %lu rules\n", rs->len);
+	return rs;
+}
@@ -0,0 +1,21 @@
+#ifndef RELOAD_H
+#define RELOAD_H
+#include "configuration.h"
+#include "ruleset.h"
+#include <stdbool.h>
+
+// The config directory is watched with inotify. On changes the config is
+// parsed and compiled on a worker thread, the main loop then takes the new
+// rules between gestures.
+
+// Watch config at path, returns the inotify fd or -1 on error
+int reload_init(const char *path);
+// Fd readable once a reparsed config is ready
+int reload_result_fd(void);
+// Read inotify events and start reparsing if the config changed
+void reload_handle_watch(void);
+// Collect a finished reparse, true if valid rules are waiting to be taken
+bool reload_handle_result(void);
+// Take new rules and settings, NULL if nothing is waiting
+ruleset *reload_take(settings *s);
+#endif
@@ -0,0 +1,216 @@
+#include "libinput-touchscreen.h"
+#include "calibration.h"
+#include "capture.h"
+#include "configuration.h"
+#include "evdev-backend.h"
+#include "gesture.h"
+#include "ruleset.h"
+#include "scheduler.h"
+#include "update.h"
+#include "touchdevice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Replay a touch capture through the recognizer without any input device.
+// All touchscreens in the capture share the calibration given with -d.
+// Time only advances with the recorded timestamps, so results are the same
+// on every run and independent of the replay speed. Hold timers expire on
+// that simulated clock, before the first record past their deadline.
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void print_recognized(const gesture *g, const ruleset *rules, uint64_t time) {
+	const rule *r;
+	printf("%10.3f ", time / 1e6);
+	print_gesture(g);
+	if ((r = ruleset_match(rules, g)) != NULL) {
+		printf("%10s Trigger %s\n", "", r->command);
+	}
+}
+
+// print continuous updates due at time
+static void print_updates(uint64_t time, uint64_t start, bool quiet) {
+	char command[sizeof ((rule *)0)->command + 32];
+	const rule *r;
+	double delta;
+	while (update_next(time, &r, &delta)) {
+		update_command(command, sizeof command, r->command, delta);
+		if (!quiet) {
+			printf("%10.3f %10s Update %s\n", (time - start) / 1e6, "", command);
+		}
+	}
+}
+
+// feed all records through the recognizer, returns number of gestures
+size_t replay(const capture *c, movement *screen, const ruleset *rules, bool quiet) {
+	slots *devices[MAX_DEVICES] = {0}, *touches;
+	continuous cont[MAX_DEVICES] = {0};
+	const touch_record *t;
+	gesture g;
+	size_t gestures = 0;
+	uint64_t deadline;
+	int id;
+	for (size_t i = 0; i < c->len; i++) {
+		t = c->records + i;
+		// rate limited updates are due before this record
+		while (update_deadline() < t->time) {
+			print_updates(update_deadline(), c->records[0].time, quiet);
+		}
+		// timer ids are device indices
+		while ((id = sched_expired(t->time)) >= 0) {
+			deadline = hold_deadline(devices[id], rules);
+			if (handle_hold(devices[id], screen, rules, t->time, &g)) {
+				gestures++;
+				if (!quiet) {
+					print_recognized(&g, rules, deadline - c->records[0].time);
+				}
+			}
+		}
+		if (t->device >= MAX_DEVICES) {
+			logger("Skip record %lu of device %d\n", i, t->device);
+			continue;
+		}
+		// the capture does not know the touch count, allow all slots
+		if ((touches = devices[t->device]) == NULL) {
+			touches = devices[t->device] = slots_new(MAX_SLOTS);
+		}
+		handle_touch(t, touches);
+		// the daemon evaluates gestures once per frame
+		if (t->type != TT_FRAME) {
+			continue;
+		}
+		if (prune_sequence(touches, screen, rules)) {
+			continue;
+		}
+		if (handle_streaming(touches, screen, rules, &g) ||
+		    handle_movements(touches, screen, rules, &g)) {
+			gestures++;
+			if (!quiet) {
+				print_recognized(&g, rules, t->time - c->records[0].time);
+			}
+		}
+		handle_continuous(touches, rules, cont + t->device, t->time);
+		print_updates(t->time, c->records[0].time, quiet);
+		sched_set(t->device, hold_deadline(touches, rules));
+	}
+	while (update_deadline() != UINT64_MAX) {
+		print_updates(update_deadline(), c->records[0].time, quiet);
+	}
+	update_clear();
+	for (size_t i = 0; i < MAX_DEVICES; i++) {
+		sched_set(i, SCHED_NONE);
+		slots_destroy(devices[i]);
+	}
+	return gestures;
+}
+
+void usage(const char *name) {
+	printf("Usage: %s [-c CONFIG] [-d DIMS] [-a APP] [-n REPEAT] [-e] [-q] CAPTURE\n", name);
+	printf("  -c CONFIG  rules to match gestures against\n");
+	printf("  -a APP     match rules as if APP was the active window class\n");
+	printf("  -d DIMS    screen calibration\n");
+	printf("  -n REPEAT  replay capture REPEAT times, for throughput measurements\n");
+	printf("  -e         CAPTURE is an evemu recording, converted by the evdev backend\n");
+	printf("  -q         do not print gestures\n");
+}
+
+int main(int argc, char **argv) {
+	char *config = get_conf_path(CONFIG_PATH);
+	char *display = get_conf_path(DISPLAYCONF);
+	size_t repeat = 1, gestures = 0;
+	const char *app = "";
+	bool quiet = false, evemu = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:d:a:n:eqh")) != -1) {
+		switch (opt) {
+		case 'e':
+			evemu = true;
+			break;
+		case 'a':
+			app = optarg;
+			break;
+		case 'c':
+			free(config);
+			config = strdup(optarg);
+			break;
+		case 'd':
+			free(display);
+			display = strdup(optarg);
+			break;
+		case 'n':
+			repeat = strtoul(optarg, NULL, 10);
+			break;
+		case 'q':
+			quiet = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (optind >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	capture *c, recording = {0};
+	size_t evdev_events;
+	uint64_t start = now_ns();
+	if (evemu) {
+		recording.records = evdev_load_evemu(argv[optind], &evdev_events, &recording.len);
+		if (recording.records == NULL) {
+			return 1;
+		}
+		printf("Converted %lu evdev events into %lu records in %.3f ms\n", evdev_events,
+		       recording.len, (now_ns() - start) / 1e6);
+		c = &recording;
+	} else if ((c = capture_open(argv[optind])) == NULL) {
+		return 1;
+	}
+	if (access(display, F_OK) == -1) {
+		printf("Missing screen calibration %s\n", display);
+		return 1;
+	}
+	movement screen = read_screen_dimensions(display);
+	settings s = {0};
+	list *rulelist = load_rules(config, &s);
+	ruleset *rules = ruleset_compile(rulelist);
+	if (rulelist != NULL) {
+		list_destroy(rulelist);
+	}
+	ruleset_activate(rules, app, app);
+	set_direction_mode(s.directions, s.deadzone);
+	set_hold_time(s.hold);
+	set_edge_distance(s.edge);
+
+	start = now_ns();
+	for (size_t i = 0; i < repeat; i++) {
+		gestures += replay(c, &screen, rules, quiet || i > 0);
+	}
+	uint64_t elapsed = now_ns() - start;
+
+	size_t events = c->len * repeat;
+	double recorded = c->len ? (double)(c->records[c->len - 1].time - c->records[0].time) * repeat / 1e6 : 0;
+	printf("Replayed %lu events, %lu gestures in %.3f ms\n", events, gestures, elapsed / 1e6);
+	if (events) {
+		printf("%.1f ns/event, %.0fx real-time\n", (double)elapsed / events, recorded / (elapsed / 1e9));
+	}
+
+	ruleset_destroy(rules);
+	if (evemu) {
+		free((touch_record *)recording.records);
+	} else {
+		capture_close(c);
+	}
+	free(config);
+	free(display);
+	return 0;
+}
@@ -0,0 +1,234 @@
+#include "ruleset.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// enter rule into all cells it covers, keeping existing rules of equal or
+// higher priority so earlier rules in the config win ties
+static void profile_insert(profile *p, const rule *r) {
+	const rule **cell;
+	enum DIRECTION dmin = r->key.dir, dmax = r->key.dir;
+	if (r->key.type == GT_SHAPE) {
+		for (size_t n = r->key.num; n <= r->maxnum; n++) {
+			cell = &p->shapes[r->key.shape][n];
+			if (*cell == NULL || (*cell)->priority < r->priority) {
+				*cell = r;
+			}
+		}
+		return;
+	}
+	if (r->anydir) {
+		dmin = DIR_NONE;
+		dmax = DIR_NUM - 1;
+	}
+	for (enum DIRECTION d = dmin; d <= dmax; d++) {
+		for (size_t n = r->key.num; n <= r->maxnum; n++) {
+			cell = r->zoned ? &p->zoned[r->zone][r->key.type][d][n] : &p->table[r->key.type][d][n];
+			if (*cell == NULL || (*cell)->priority < r->priority) {
+				*cell = r;
+			}
+		}
+	}
+}
+
+// index of a template in the ruleset, added if it is new
+static uint8_t ruleset_template(ruleset *rs, const shape *s) {
+	for (size_t i = 0; i < rs->ntemplates; i++) {
+		if (memcmp(rs->templates + i, s, sizeof *s) == 0) {
+			return i;
+		}
+	}
+	rs->templates[rs->ntemplates] = *s;
+	return rs->ntemplates++;
+}
+
+// index of a zone in the ruleset, added if it is new
+static uint8_t ruleset_zone(ruleset *rs, const zone *z) {
+	for (size_t i = 0; i < rs->nzones; i++) {
+		if (memcmp(rs->zones + i, z, sizeof *z) == 0) {
+			return i;
+		}
+	}
+	rs->zones[rs->nzones] = *z;
+	return rs->nzones++;
+}
+
+// find profile of an application, or add it, names compare like in ruleset_activate
+static profile *ruleset_profile(ruleset *rs, const char *app) {
+	for (size_t i = 0; i < rs->nprofiles; i++) {
+		if (strcasecmp(rs->profiles[i].app, app) == 0) {
+			return rs->profiles + i;
+		}
+	}
+	// profiles are large, so they grow one by one while compiling
+	rs->profiles = realloc(rs->profiles, (rs->nprofiles + 1) * sizeof *rs->profiles);
+	memset(rs->profiles + rs->nprofiles, 0, sizeof *rs->profiles);
+	rs->profiles[rs->nprofiles].app = app;
+	return rs->profiles + rs->nprofiles++;
+}
+
+// let cells without rule fall back to the same cell of another table
+static void table_fallback(const rule **cell, const rule *const *global, size_t n) {
+	for (size_t c = 0; c < n; c++) {
+		if (cell[c] == NULL) {
+			cell[c] = global[c];
+		}
+	}
+}
+
+// widen the interest summary by a rule
+static void interest_add(interest *w, const rule *r) {
+	if (r->zoned) {
+		w->zoned[r->zone] = r->maxnum > w->zoned[r->zone] ? r->maxnum : w->zoned[r->zone];
+	} else if (r->key.type == GT_BORDER) {
+		// border gestures always have a single finger
+		w->border |= r->key.num <= 1 && r->maxnum >= 1;
+	} else if (r->maxnum > w->fingers) {
+		w->fingers = r->maxnum;
+	}
+}
+
+// fill the profile tables and flags from all enabled rules
+static void ruleset_build(ruleset *rs) {
+	size_t i;
+	for (i = 0; i < rs->nprofiles; i++) {
+		memset(rs->profiles[i].table, 0, sizeof rs->profiles[i].table);
+		memset(rs->profiles[i].shapes, 0, sizeof rs->profiles[i].shapes);
+		if (rs->nzones > 0) {
+			memset(rs->profiles[i].zoned, 0, rs->nzones * sizeof *rs->profiles[i].zoned);
+		}
+	}
+	rs->streaming = rs->timed = rs->continuous = false;
+	memset(&rs->want, 0, sizeof rs->want);
+	for (i = 0; i < rs->len; i++) {
+		if (rs->disabled[i]) {
+			continue;
+		}
+		profile_insert(ruleset_profile(rs, rs->rules[i].app), rs->rules + i);
+		interest_add(&rs->want, rs->rules + i);
+		rs->streaming |= rs->rules[i].early > 0;
+		rs->timed |= rs->rules[i].key.type == GT_HOLD || rs->rules[i].key.type == GT_LONGPRESS;
+		rs->continuous |= rs->rules[i].key.type == GT_PINCH || rs->rules[i].key.type == GT_ROTATE;
+	}
+	// application profiles fall back to global rules
+	for (i = 1; i < rs->nprofiles; i++) {
+		table_fallback(&rs->profiles[i].table[0][0][0], &rs->profiles[0].table[0][0][0],
+			       RULE_TYPES * RULE_DIRS * (RULE_MAX_FINGERS + 1));
+		table_fallback(&rs->profiles[i].shapes[0][0], &rs->profiles[0].shapes[0][0],
+			       SHAPE_MAX_TEMPLATES * (RULE_MAX_FINGERS + 1));
+		for (size_t z = 0; z < rs->nzones; z++) {
+			table_fallback(&rs->profiles[i].zoned[z][0][0][0], &rs->profiles[0].zoned[z][0][0][0],
+				       RULE_TYPES * RULE_DIRS * (RULE_MAX_FINGERS + 1));
+		}
+	}
+}
+
+ruleset *ruleset_compile(list *rules) {
+	ruleset *rs = calloc(1, sizeof *rs);
+	size_t i = 0;
+	rs->profiles = calloc(1, sizeof *rs->profiles);
+	rs->profiles->app = "";
+	rs->nprofiles = 1;
+	if (rules == NULL) {
+		return rs;
+	}
+	rs->len = list_len(rules);
+	rs->rules = calloc(rs->len, sizeof *rs->rules);
+	for (node *cur = rules->head; cur != NULL; cur = cur->next) {
+		memcpy(rs->rules + i++, cur->value, sizeof *rs->rules);
+	}
+	rs->templates = calloc(SHAPE_MAX_TEMPLATES, sizeof *rs->templates);
+	rs->zones = calloc(ZONE_MAX, sizeof *rs->zones);
+	rs->disabled = calloc(rs->len, sizeof *rs->disabled);
+	rs->hits = calloc(rs->len, sizeof *rs->hits);
+	// the config declares at most SHAPE_MAX_TEMPLATES distinct templates
+	for (i = 0; i < rs->len; i++) {
+		if (rs->rules[i].key.type == GT_SHAPE) {
+			rs->rules[i].key.shape = ruleset_template(rs, &rs->rules[i].tmpl);
+		}
+		// and at most ZONE_MAX distinct zones
+		if (rs->rules[i].zoned) {
+			rs->rules[i].zone = ruleset_zone(rs, &rs->rules[i].area);
+		}
+		// profiles are created in config order, including those of disabled rules
+		ruleset_profile(rs, rs->rules[i].app);
+	}
+	if (rs->nzones > 0) {
+		rs->grid = zone_grid_new(rs->zones, rs->nzones);
+		for (i = 0; i < rs->nprofiles; i++) {
+			rs->profiles[i].zoned = calloc(rs->nzones, sizeof *rs->profiles[i].zoned);
+		}
+	}
+	ruleset_build(rs);
+	logger("Compiled %lu rules in %lu profiles\n", rs->len, rs->nprofiles);
+	logger("Interest: up to %d fingers anywhere, border %d, %lu zones\n", rs->want.fingers, rs->want.border,
+	       rs->nzones);
+	return rs;
+}
+
+bool ruleset_enable(ruleset *rs, size_t i, bool enabled) {
+	if (i >= rs->len) {
+		return false;
+	}
+	rs->disabled[i] = !enabled;
+	ruleset_build(rs);
+	return true;
+}
+
+void ruleset_hit(const ruleset *rs, const rule *r) {
+	rs->hits[r - rs->rules]++;
+}
+
+void ruleset_destroy(ruleset *rs) {
+	for (size_t i = 0; i < rs->nprofiles; i++) {
+		free(rs->profiles[i].zoned);
+	}
+	free(rs->zones);
+	free(rs->grid);
+	free(rs->disabled);
+	free(rs->hits);
+	free(rs->profiles);
+	free(rs->rules);
+	free(rs->templates);
+	free(rs);
+}
+
+void ruleset_activate(ruleset *rs, const char *class, const char *instance) {
+	rs->active = 0;
+	for (size_t i = 1; i < rs->nprofiles; i++) {
+		if (strcasecmp(rs->profiles[i].app, class) == 0 ||
+		    strcasecmp(rs->profiles[i].app, instance) == 0) {
+			rs->active = i;
+			break;
+		}
+	}
+	logger("Active profile %s\n", rs->profiles[rs->active].app);
+}
+
+const rule *ruleset_match(const ruleset *rs, const gesture *g) {
+	if (g->type == GT_SHAPE) {
+		if (g->shape >= rs->ntemplates || g->num > RULE_MAX_FINGERS) {
+			return NULL;
+		}
+		return rs->profiles[rs->active].shapes[g->shape][g->num];
+	}
+	if (g->type >= RULE_TYPES || g->dir >= RULE_DIRS || g->num > RULE_MAX_FINGERS) {
+		return NULL;
+	}
+	const profile *p = rs->profiles + rs->active;
+	const rule *best = NULL, *r;
+	zonemask zones = g->zones;
+	size_t z;
+	// only the few zones containing the start are visited
+	while (zones && p->zoned != NULL) {
+		z = __builtin_ctz(zones);
+		zones &= zones - 1;
+		if (z < rs->nzones && (r = p->zoned[z][g->type][g->dir][g->num]) != NULL &&
+		    (best == NULL || r->priority > best->priority)) {
+			best = r;
+		}
+	}
+	return best != NULL ? best : p->table[g->type][g->dir][g->num];
+}
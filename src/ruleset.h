@@ -0,0 +1,62 @@
+#ifndef RULESET_H
+#define RULESET_H
+#include "libinput-touchscreen.h"
+#include "list.h"
+#define RULE_MAX_FINGERS 16  // highest finger count usable in rules
+#define RULE_TYPES (GT_ROTATE + 1)
+#define RULE_DIRS DIR_NUM
+
+// Rules compiled into a table directly indexed by gesture type, direction
+// and finger count. Wildcards, ranges and priorities are resolved when
+// compiling, so matching is a single lookup regardless of the rule count.
+typedef struct profile {
+	const char *app;  // application class, empty for the global profile
+	const rule *table[RULE_TYPES][RULE_DIRS][RULE_MAX_FINGERS + 1];
+	const rule *shapes[SHAPE_MAX_TEMPLATES][RULE_MAX_FINGERS + 1];  // by template index
+	const rule *(*zoned)[RULE_TYPES][RULE_DIRS][RULE_MAX_FINGERS + 1];  // one table per zone
+} profile;
+
+// What touch sequences the enabled rules of all profiles can still match,
+// so sequences no rule can match are not tracked any further.
+typedef struct interest {
+	uint8_t fingers;  // most fingers of rules that may start anywhere
+	bool border;  // any single finger border rule
+	uint8_t zoned[ZONE_MAX];  // most fingers of rules bound to each zone
+} interest;
+
+// Every application section gets its own profile table, which already
+// contains the global rules for gestures the section does not define.
+typedef struct ruleset {
+	rule *rules;  // all rules in config order
+	size_t len;
+	bool *disabled;  // rules left out of the tables, by rule index
+	uint64_t *hits;  // times each rule triggered, by rule index
+	bool streaming;  // any rule triggers before lift
+	bool timed;  // any hold or longpress rule
+	bool continuous;  // any pinch or rotate rule
+	profile *profiles;  // global profile first
+	size_t nprofiles;
+	size_t active;  // profile used for matching
+	shape *templates;  // distinct templates of all shape rules
+	size_t ntemplates;
+	zone *zones;  // distinct areas of all zoned rules
+	size_t nzones;
+	zone_grid *grid;  // lookup of the zones, NULL without zones
+	interest want;  // summary of all enabled rules
+} ruleset;
+
+// Compile a list of rules into a ruleset
+ruleset *ruleset_compile(list *rules);
+// Enable or disable rule i and rebuild the tables, false if there is no rule i
+bool ruleset_enable(ruleset *rs, size_t i, bool enabled);
+// Count a trigger of a rule of the ruleset
+void ruleset_hit(const ruleset *rs, const rule *r);
+// Free ruleset and contained rules
+void ruleset_destroy(ruleset *rs);
+// Select the profile of an application by WM_CLASS class or instance name
+void ruleset_activate(ruleset *rs, const char *class, const char *instance);
+// Find the rule triggered by a gesture in the active profile, NULL if none
+// matches. Rules of the zones the gesture started in take precedence, among
+// them the highest priority and then the first zone wins.
+const rule *ruleset_match(const ruleset *rs, const gesture *g);
+#endif
@@ -0,0 +1,91 @@
+#include "scheduler.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t deadlines[SCHED_MAX_TIMERS] = {
+	[0 ... SCHED_MAX_TIMERS - 1] = SCHED_NONE,
+};
+static uint64_t armed = SCHED_NONE;  // deadline the timerfd is set to
+static int tfd = -1;
+
+int sched_init(void) {
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (tfd == -1) {
+		printf("Failed to create timer: %s\n", strerror(errno));
+	}
+	return tfd;
+}
+
+int sched_fd(void) {
+	return tfd;
+}
+
+void sched_set(size_t id, uint64_t deadline) {
+	if (id < SCHED_MAX_TIMERS) {
+		deadlines[id] = deadline;
+	}
+}
+
+uint64_t sched_next(void) {
+	uint64_t next = SCHED_NONE;
+	for (size_t i = 0; i < SCHED_MAX_TIMERS; i++) {
+		next = deadlines[i] < next ? deadlines[i] : next;
+	}
+	return next;
+}
+
+int sched_expired(uint64_t now) {
+	for (size_t i = 0; i < SCHED_MAX_TIMERS; i++) {
+		if (deadlines[i] <= now) {
+			deadlines[i] = SCHED_NONE;
+			return i;
+		}
+	}
+	return -1;
+}
+
+void sched_arm(void) {
+	uint64_t next = sched_next(), expirations;
+	struct itimerspec its = {0};
+	if (tfd == -1) {
+		return;
+	}
+	// consume a pending expiration, so the fd only polls readable for new ones
+	if (read(tfd, &expirations, sizeof expirations) == sizeof expirations) {
+		armed = SCHED_NONE;
+	}
+	if (next == armed) {
+		return;
+	}
+	// a zero it_value disarms, so deadlines in the past become 1 ns
+	if (next != SCHED_NONE) {
+		its.it_value.tv_sec = next / 1000000;
+		its.it_value.tv_nsec = next % 1000000 * 1000;
+		if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+			its.it_value.tv_nsec = 1;
+		}
+	}
+	if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+		printf("Failed to arm timer: %s\n", strerror(errno));
+		return;
+	}
+	armed = next;
+}
+
+uint64_t sched_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void sched_destroy(void) {
+	if (tfd != -1) {
+		close(tfd);
+		tfd = -1;
+	}
+}
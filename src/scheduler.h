@@ -0,0 +1,30 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include <stddef.h>
+#include <stdint.h>
+#define SCHED_MAX_TIMERS 32  // number of timer ids
+#define SCHED_NONE UINT64_MAX  // deadline of a disarmed timer
+
+// Deadlines of a fixed set of timers, identified by small ids chosen by the
+// caller, in us of CLOCK_MONOTONIC like libinput event times. A timerfd is
+// armed for the earliest deadline only, so nothing wakes up while no timer
+// is armed. Without the timerfd the deadlines can be driven by a simulated
+// clock.
+
+// Create the timerfd, returns it or -1 on error
+int sched_init(void);
+// Timerfd readable once the earliest deadline passed, -1 if none
+int sched_fd(void);
+// Set the deadline of a timer, SCHED_NONE disarms it
+void sched_set(size_t id, uint64_t deadline);
+// Earliest deadline of all timers, SCHED_NONE if none is armed
+uint64_t sched_next(void);
+// Disarm and return a timer expired at now, -1 if none
+int sched_expired(uint64_t now);
+// Clear the timerfd and arm it for the earliest deadline, call before polling
+void sched_arm(void);
+// Current CLOCK_MONOTONIC time in us
+uint64_t sched_now(void);
+// Close the timerfd
+void sched_destroy(void);
+#endif
@@ -0,0 +1,105 @@
+#include "shape.h"
+
+#include <math.h>
+
+static inline float distance(float x0, float y0, float x1, float y1) {
+	return sqrtf((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+}
+
+// resample the path into SHAPE_POINTS points evenly spaced along it
+static bool resample(const float *x, const float *y, size_t n, shape *out) {
+	float len = 0, step, acc = 0, d, t, px, py;
+	size_t k = 1;
+	for (size_t i = 1; i < n; i++) {
+		len += distance(x[i - 1], y[i - 1], x[i], y[i]);
+	}
+	if (n < 2 || len <= 0) {
+		return false;
+	}
+	step = len / (SHAPE_POINTS - 1);
+	px = out->x[0] = x[0];
+	py = out->y[0] = y[0];
+	for (size_t i = 1; i < n && k < SHAPE_POINTS; i++) {
+		d = distance(px, py, x[i], y[i]);
+		// emit all points falling onto this segment
+		while (acc + d >= step && k < SHAPE_POINTS) {
+			t = (step - acc) / d;
+			px += t * (x[i] - px);
+			py += t * (y[i] - py);
+			out->x[k] = px;
+			out->y[k++] = py;
+			d = distance(px, py, x[i], y[i]);
+			acc = 0;
+		}
+		acc += d;
+		px = x[i];
+		py = y[i];
+	}
+	// rounding can leave the last points unset
+	for (; k < SHAPE_POINTS; k++) {
+		out->x[k] = x[n - 1];
+		out->y[k] = y[n - 1];
+	}
+	return true;
+}
+
+bool shape_from_path(const float *x, const float *y, size_t n, shape *out) {
+	float cx = 0, cy = 0, xmin, xmax, ymin, ymax, scale;
+	if (!resample(x, y, n, out)) {
+		return false;
+	}
+	xmin = xmax = out->x[0];
+	ymin = ymax = out->y[0];
+	for (size_t i = 0; i < SHAPE_POINTS; i++) {
+		cx += out->x[i];
+		cy += out->y[i];
+		xmin = fminf(xmin, out->x[i]);
+		xmax = fmaxf(xmax, out->x[i]);
+		ymin = fminf(ymin, out->y[i]);
+		ymax = fmaxf(ymax, out->y[i]);
+	}
+	cx /= SHAPE_POINTS;
+	cy /= SHAPE_POINTS;
+	scale = fmaxf(xmax - xmin, ymax - ymin);
+	if (scale <= 0) {
+		return false;
+	}
+	for (size_t i = 0; i < SHAPE_POINTS; i++) {
+		out->x[i] = (out->x[i] - cx) / scale;
+		out->y[i] = (out->y[i] - cy) / scale;
+	}
+	return true;
+}
+
+float shape_distance(const shape *a, const shape *b, float limit) {
+	float lanes[SHAPE_LANES] = {0}, sum = 0, dx, dy;
+	limit *= SHAPE_POINTS;
+	for (size_t i = 0; i < SHAPE_POINTS; i += SHAPE_LANES) {
+		// independent lanes, so the inner loop vectorizes without reassociation
+		for (size_t j = 0; j < SHAPE_LANES; j++) {
+			dx = a->x[i + j] - b->x[i + j];
+			dy = a->y[i + j] - b->y[i + j];
+			lanes[j] += dx * dx + dy * dy;
+		}
+		sum = 0;
+		for (size_t j = 0; j < SHAPE_LANES; j++) {
+			sum += lanes[j];
+		}
+		if (sum > limit) {
+			break;
+		}
+	}
+	return sum / SHAPE_POINTS;
+}
+
+int shape_match(const shape *stroke, const shape *templates, size_t n) {
+	float best = SHAPE_THRESHOLD, d;
+	int index = -1;
+	for (size_t i = 0; i < n; i++) {
+		if ((d = shape_distance(stroke, templates + i, best)) < best) {
+			best = d;
+			index = i;
+		}
+	}
+	return index;
+}
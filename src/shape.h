@@ -0,0 +1,25 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+#include <stdbool.h>
+#include <stddef.h>
+#define SHAPE_POINTS 32  // points strokes and templates are resampled to
+#define SHAPE_LANES 8  // points compared per step, a multiple of the simd width
+#define SHAPE_MAX_TEMPLATES 64  // most templates a config can declare
+#define SHAPE_THRESHOLD 0.01f  // highest mean squared point distance of a match
+
+// Strokes are compared in the style of the $1 recognizer: the path is
+// resampled to equidistant points, centered on its centroid and scaled to
+// unit size, keeping the aspect ratio so lines stay lines. Rotation is not
+// normalized, so shapes keep their orientation like swipes keep direction.
+typedef struct shape {
+	float x[SHAPE_POINTS];
+	float y[SHAPE_POINTS];
+} shape;
+
+// Normalize a path of n points into a shape, false if the path has no extent
+bool shape_from_path(const float *x, const float *y, size_t n, shape *out);
+// Mean squared distance of corresponding points, stops once above limit
+float shape_distance(const shape *a, const shape *b, float limit);
+// Index of the closest of n templates within SHAPE_THRESHOLD, -1 if none
+int shape_match(const shape *stroke, const shape *templates, size_t n);
+#endif
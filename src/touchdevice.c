@@ -0,0 +1,199 @@
+#include "touchdevice.h"
+#include "calibration.h"
+#include "configuration.h"
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static touch_device *devices[MAX_DEVICES];
+static pthread_mutex_t devices_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool interactive = false;  // calibrate devices without calibration by hand
+
+void device_calibrate_interactively(bool on) {
+	interactive = on;
+}
+
+// path of a per device calibration file
+static char *device_conf_path(const char *format, uint16_t vendor, uint16_t product) {
+	char filename[64];
+	snprintf(filename, sizeof filename, format, vendor, product);
+	return get_conf_path(filename);
+}
+
+// Load the calibration of the device, falling back to the shared one. Without
+// either, the edges are learned from touches, starting from the last learned
+// calibration or the device size. Devices of unknown size are calibrated by
+// hand if enabled.
+static void device_screen(touch_device *d, const char *devpath, double width, double height) {
+	char *path = device_conf_path(DEVICE_DISPLAYCONF, d->vendor, d->product);
+	char *learned = device_conf_path(DEVICE_LEARNEDCONF, d->vendor, d->product);
+	char *fallback = get_conf_path(DISPLAYCONF);
+	d->screen = (movement){{0}};
+	if (access(path, F_OK) != -1) {
+		d->screen = read_screen_dimensions(path);
+	} else if (access(fallback, F_OK) != -1) {
+		d->screen = read_screen_dimensions(fallback);
+	} else if (width > 0 && height > 0) {
+		d->screen = (movement){.end = {width, height}};
+		if (access(learned, F_OK) != -1) {
+			d->screen = read_screen_dimensions(learned);
+		} else {
+			printf("Calibration from device size %.1fx%.1fmm\n", width, height);
+		}
+		edges_init(&d->edges, width, height, &d->screen);
+		d->learning = true;
+	} else if (devpath != NULL && interactive) {
+		d->screen = calibrate_touchscreen(devpath, path);
+	} else if (devpath != NULL) {
+		printf("No calibration for %s, edges are not detected\n", devpath);
+	}
+	free(path);
+	free(learned);
+	free(fallback);
+}
+
+touch_device *device_attach(const char *name, const char *devpath, uint16_t vendor, uint16_t product,
+			    double width, double height, size_t count) {
+	touch_device *d;
+	size_t i;
+	for (i = 0; i < MAX_DEVICES && devices[i] != NULL; i++);
+	if (i == MAX_DEVICES) {
+		printf("Ignoring %s, too many touchscreens\n", name);
+		return NULL;
+	}
+	d = calloc(1, sizeof *d);
+	d->index = i;
+	d->vendor = vendor;
+	d->product = product;
+	device_screen(d, devpath, width, height);
+	d->touches = slots_new(count);
+	devices[i] = d;
+	printf("Device added: %s (%s), %zu slots\n", name, devpath ? devpath : "virtual", d->touches->capacity);
+	return d;
+}
+
+void device_detach(touch_device *d) {
+	devices[d->index] = NULL;
+	slots_destroy(d->touches);
+	free(d);
+}
+
+touch_device *device_add(struct libinput_device *dev) {
+	touch_device *d;
+	double width = 0, height = 0;
+	char *devpath;
+	int count;
+	if (!libinput_device_has_capability(dev, LIBINPUT_DEVICE_CAP_TOUCH)) {
+		return NULL;
+	}
+	// 0 if the device does not know, -1 on error
+	count = libinput_device_touch_get_touch_count(dev);
+	devpath = get_devpath(dev);
+	libinput_device_get_size(dev, &width, &height);
+	d = device_attach(libinput_device_get_name(dev), devpath, libinput_device_get_id_vendor(dev),
+			  libinput_device_get_id_product(dev), width, height,
+			  count > 0 ? (size_t)count : MOV_SLOTS);
+	free(devpath);
+	if (d == NULL) {
+		return NULL;
+	}
+	d->dev = libinput_device_ref(dev);
+	libinput_device_set_user_data(dev, d);
+	return d;
+}
+
+void device_remove(struct libinput_device *dev) {
+	touch_device *d = libinput_device_get_user_data(dev);
+	if (d == NULL) {
+		return;
+	}
+	printf("Device removed: %s\n", libinput_device_get_sysname(dev));
+	libinput_device_set_user_data(dev, NULL);
+	libinput_device_unref(d->dev);
+	device_detach(d);
+}
+
+void devices_lock(void) {
+	pthread_mutex_lock(&devices_mutex);
+}
+
+void devices_unlock(void) {
+	pthread_mutex_unlock(&devices_mutex);
+}
+
+touch_device *device_get(size_t index) {
+	return index < MAX_DEVICES ? devices[index] : NULL;
+}
+
+bool devices_any_down(void) {
+	for (size_t i = 0; i < MAX_DEVICES; i++) {
+		if (devices[i] != NULL && any_down(devices[i]->touches)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+touch_device *device_handle_event(struct libinput_event *event) {
+	struct libinput_device *dev = libinput_event_get_device(event);
+	touch_record t = {0};
+	touch_device *d;
+	switch (libinput_event_get_type(event)) {
+	case LIBINPUT_EVENT_DEVICE_ADDED:
+		device_add(dev);
+		return NULL;
+	case LIBINPUT_EVENT_DEVICE_REMOVED:
+		device_remove(dev);
+		return NULL;
+	default:
+		break;
+	}
+	if ((d = libinput_device_get_user_data(dev)) == NULL) {
+		return NULL;
+	}
+	if (!touch_from_event(event, &t)) {
+		printf("Unknown event type. %d\n", libinput_event_get_type(event));
+		return NULL;
+	}
+	t.device = d->index;
+	device_record(d, &t);
+	return t.type == TT_FRAME ? d : NULL;
+}
+
+void device_record(touch_device *d, const touch_record *t) {
+	handle_record(t, d->touches);
+	if (t->type != TT_DOWN || !d->learning) {
+		return;
+	}
+	if (edges_learn(&d->edges, (vec2){t->x, t->y}, &d->screen) && d->changed == 0) {
+		d->changed = trace_now();
+	}
+}
+
+uint64_t devices_save_deadline(void) {
+	uint64_t deadline = UINT64_MAX;
+	for (size_t i = 0; i < MAX_DEVICES; i++) {
+		if (devices[i] != NULL && devices[i]->changed != 0 && devices[i]->changed < deadline) {
+			deadline = devices[i]->changed;
+		}
+	}
+	return deadline == UINT64_MAX ? deadline : deadline + CALIBRATION_SAVE_INTERVAL * 1000;
+}
+
+void devices_save(uint64_t now) {
+	touch_device *d;
+	char *path;
+	for (size_t i = 0; i < MAX_DEVICES; i++) {
+		d = devices[i];
+		if (d == NULL || d->changed == 0 || d->changed + CALIBRATION_SAVE_INTERVAL * 1000 > now) {
+			continue;
+		}
+		path = device_conf_path(DEVICE_LEARNEDCONF, d->vendor, d->product);
+		// another write is still running, try again later
+		d->changed = write_screen_dimensions_async(path, &d->screen) ? 0 : now;
+		free(path);
+	}
+}
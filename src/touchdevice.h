@@ -0,0 +1,54 @@
+#ifndef TOUCHDEVICE_H
+#define TOUCHDEVICE_H
+#include "libinput-touchscreen.h"
+#include "calibration.h"
+#include "gesture.h"
+#define MAX_DEVICES 8  // maximum number of simultaneously connected touchscreens
+#define DEVICE_DISPLAYCONF "dims-%04x:%04x.txt"  // per device calibration, by usb id
+#define DEVICE_LEARNEDCONF "dims-%04x:%04x.learned"  // calibration learned from touches
+
+typedef struct touch_device {
+	struct libinput_device *dev;  // NULL for devices of the evdev backend
+	uint8_t index;  // position in the device table, stored in capture records
+	movement screen;  // calibrated screen dimensions
+	slots *touches;  // sized by the touch count of the device
+	continuous cont;  // running pinch or rotate
+	uint16_t vendor;
+	uint16_t product;
+	bool learning;  // screen edges are learned from touch downs
+	edge_estimator edges;
+	uint64_t changed;  // time in us of the first unsaved learned change, 0 if none
+} touch_device;
+
+// Calibrate devices by hand if there is no calibration and their size is unknown
+void device_calibrate_interactively(bool on);
+// Set up state for a touchscreen of any backend with count slots and a size
+// in mm (0 if unknown), NULL if there are too many touchscreens. Virtual ones
+// without devpath are never calibrated by hand.
+touch_device *device_attach(const char *name, const char *devpath, uint16_t vendor, uint16_t product,
+			    double width, double height, size_t count);
+// Drop state of a touchscreen of any backend
+void device_detach(touch_device *d);
+// Set up state for a new libinput device, NULL if it is no touchscreen
+touch_device *device_add(struct libinput_device *dev);
+// Drop state of a removed libinput device
+void device_remove(struct libinput_device *dev);
+// The device table only changes while holding the lock. The recognizer
+// holds it except while waiting for input, so an ingestion thread can
+// attach and detach devices in between.
+void devices_lock(void);
+void devices_unlock(void);
+// Device at table index, NULL if unused
+touch_device *device_get(size_t index);
+// Check whether a finger is down on any touchscreen
+bool devices_any_down(void);
+// Fill the slots of a device with a touch record and learn its edges
+void device_record(touch_device *d, const touch_record *t);
+// Deadline in us for writing learned calibrations, UINT64_MAX if none changed
+uint64_t devices_save_deadline(void);
+// Write learned calibrations due at now in the background
+void devices_save(uint64_t now);
+// Handle device and touch events, returns the device whose touch frame
+// completed with this event or NULL
+touch_device *device_handle_event(struct libinput_event *event);
+#endif
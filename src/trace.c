@@ -0,0 +1,171 @@
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Log-linear histogram, each power of two is split into 2^TRACE_SUB_BITS
+// linear buckets. Counters are atomics, so recording never takes a lock.
+typedef struct histogram {
+	_Atomic uint64_t buckets[TRACE_BUCKETS];
+	_Atomic uint64_t count;
+	_Atomic uint64_t max;
+} histogram;
+
+static const char *stage_names[TRACE_STAGES] = {"dequeue", "classify", "match", "spawn"};
+static histogram histograms[TRACE_STAGES];
+static _Atomic uint64_t lag_incidents;
+static _Atomic uint64_t first_wakeup;  // time in us of the first wakeup
+static _Atomic uint64_t wakeups;
+static _Atomic uint64_t input_wakeups;  // wakeups with libinput events
+static _Atomic uint64_t input_events;
+static _Atomic uint64_t pruned_sequences;
+static _Atomic uint64_t pruned_events;  // touch motion and frames skipped
+static _Atomic uint64_t ring_max;  // most records queued in the ring
+static _Atomic uint64_t backpressure;
+static _Atomic uint64_t overflows;
+static _Atomic uint64_t last_up;
+static _Atomic uint64_t last_frame;
+
+uint64_t trace_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static size_t bucket_index(uint64_t v) {
+	int msb;
+	if (v < (1 << TRACE_SUB_BITS)) {
+		return v;
+	}
+	msb = 63 - __builtin_clzll(v);
+	return ((msb - TRACE_SUB_BITS + 1) << TRACE_SUB_BITS) +
+	       ((v >> (msb - TRACE_SUB_BITS)) & ((1 << TRACE_SUB_BITS) - 1));
+}
+
+// highest value falling into bucket
+static uint64_t bucket_value(size_t i) {
+	size_t shift, sub;
+	if (i < (1 << TRACE_SUB_BITS)) {
+		return i;
+	}
+	shift = (i >> TRACE_SUB_BITS) - 1;
+	sub = i & ((1 << TRACE_SUB_BITS) - 1);
+	return (((uint64_t)((1 << TRACE_SUB_BITS) + sub + 1)) << shift) - 1;
+}
+
+static void histogram_add(histogram *h, uint64_t v) {
+	uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->buckets[bucket_index(v)], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+	while (v > max && !atomic_compare_exchange_weak(&h->max, &max, v));
+}
+
+// upper bound of the bucket holding the percentile, capped at the maximum
+static uint64_t histogram_percentile(histogram *h, double p) {
+	uint64_t count = atomic_load(&h->count), seen = 0;
+	uint64_t rank = count * p / 100.0, max = atomic_load(&h->max);
+	for (size_t i = 0; i < TRACE_BUCKETS; i++) {
+		seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+		if (seen > rank) {
+			return bucket_value(i) < max ? bucket_value(i) : max;
+		}
+	}
+	return max;
+}
+
+void trace_up(uint64_t time) {
+	uint64_t now = trace_now();
+	atomic_store(&last_up, time);
+	histogram_add(histograms + TRACE_DEQUEUE, now > time ? now - time : 0);
+}
+
+void trace_frame(uint64_t time) {
+	atomic_store(&last_frame, time);
+}
+
+void trace_commit(void) {
+	atomic_store(&last_up, atomic_load(&last_frame));
+}
+
+void trace_deadline(uint64_t time) {
+	atomic_store(&last_up, time);
+}
+
+void trace_stage(enum TRACESTAGE stage) {
+	uint64_t now = trace_now(), up = atomic_load(&last_up);
+	if (up == 0) {
+		return;
+	}
+	histogram_add(histograms + stage, now > up ? now - up : 0);
+}
+
+void trace_lag(void) {
+	atomic_fetch_add(&lag_incidents, 1);
+}
+
+void trace_pruned_sequence(void) {
+	atomic_fetch_add_explicit(&pruned_sequences, 1, memory_order_relaxed);
+}
+
+void trace_pruned_event(void) {
+	atomic_fetch_add_explicit(&pruned_events, 1, memory_order_relaxed);
+}
+
+void trace_ring_fill(size_t fill) {
+	uint64_t max = atomic_load_explicit(&ring_max, memory_order_relaxed);
+	while (fill > max && !atomic_compare_exchange_weak(&ring_max, &max, fill));
+}
+
+void trace_backpressure(void) {
+	atomic_fetch_add_explicit(&backpressure, 1, memory_order_relaxed);
+}
+
+void trace_overflow(void) {
+	atomic_fetch_add_explicit(&overflows, 1, memory_order_relaxed);
+}
+
+void trace_wakeup(size_t events) {
+	uint64_t none = 0;
+	atomic_compare_exchange_strong(&first_wakeup, &none, trace_now());
+	atomic_fetch_add_explicit(&wakeups, 1, memory_order_relaxed);
+	if (events > 0) {
+		atomic_fetch_add_explicit(&input_wakeups, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&input_events, events, memory_order_relaxed);
+	}
+}
+
+void trace_dump(FILE *f) {
+	uint64_t start = atomic_load(&first_wakeup), elapsed = start ? trace_now() - start : 0;
+	uint64_t n = atomic_load(&wakeups), inputs = atomic_load(&input_wakeups);
+	histogram *h;
+	fprintf(f, "%-10s %10s %10s %10s %10s\n", "stage", "count", "p50(us)", "p99(us)", "max(us)");
+	for (int i = 0; i < TRACE_STAGES; i++) {
+		h = histograms + i;
+		fprintf(f, "%-10s %10lu %10lu %10lu %10lu\n", stage_names[i], atomic_load(&h->count),
+			histogram_percentile(h, 50), histogram_percentile(h, 99), atomic_load(&h->max));
+	}
+	fprintf(f, "lag incidents %lu\n", atomic_load(&lag_incidents));
+	fprintf(f, "wakeups %lu, %.2f/s, %.1f events/input wakeup\n", n, elapsed ? n * 1e6 / elapsed : 0,
+		inputs ? (double)atomic_load(&input_events) / inputs : 0);
+	fprintf(f, "pruned %lu sequences, %lu events\n", atomic_load(&pruned_sequences),
+		atomic_load(&pruned_events));
+	if (atomic_load(&ring_max) > 0) {
+		fprintf(f, "ring max fill %lu, %lu backpressure waits, %lu overflows\n", atomic_load(&ring_max),
+			atomic_load(&backpressure), atomic_load(&overflows));
+	}
+}
+
+void trace_write(const char *path) {
+	char tmppath[512];
+	FILE *f;
+	snprintf(tmppath, sizeof tmppath, "%s.tmp", path);
+	if ((f = fopen(tmppath, "we")) == NULL) {
+		printf("Failed to write stats to %s\n", tmppath);
+		return;
+	}
+	trace_dump(f);
+	fclose(f);
+	rename(tmppath, path);
+}
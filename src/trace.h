@@ -0,0 +1,53 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#define TRACE_SUB_BITS 4  // linear sub-buckets per power of two, as bits
+#define TRACE_BUCKETS ((64 - TRACE_SUB_BITS + 1) << TRACE_SUB_BITS)
+#define TRACE_INTERVAL 10000  // interval in ms for writing the stats file
+
+// Latencies are measured from the kernel timestamp of the touch up event
+// that completed a gesture until the named stage was reached. For gestures
+// committed before lift the last touch frame is the reference instead.
+enum TRACESTAGE {
+	TRACE_DEQUEUE,  // touch up taken from the libinput queue
+	TRACE_CLASSIFY,  // gesture recognized
+	TRACE_MATCH,  // rule found for the gesture
+	TRACE_SPAWN,  // command launched
+	TRACE_STAGES,
+};
+
+// Register the dequeue of a touch up event with kernel timestamp in us
+void trace_up(uint64_t time);
+// Register the dequeue of a touch frame with kernel timestamp in us
+void trace_frame(uint64_t time);
+// Use the last touch frame as reference for a gesture recognized before lift
+void trace_commit(void);
+// Use a timer deadline in us as reference for a gesture fired by a timer
+void trace_deadline(uint64_t time);
+// Record latency of a stage relative to the last touch up
+void trace_stage(enum TRACESTAGE stage);
+// Count a libinput event lag incident
+void trace_lag(void);
+// Count a touch sequence no rule can match anymore
+void trace_pruned_sequence(void);
+// Count a touch event of a pruned sequence
+void trace_pruned_event(void);
+// Register the number of records queued between the threads of the
+// pipelined mode
+void trace_ring_fill(size_t fill);
+// Count a record that waited for space in the full ring
+void trace_backpressure(void);
+// Count a motion record dropped because the ring was full
+void trace_overflow(void);
+// Count a poll loop wakeup that drained events from libinput, 0 for others
+void trace_wakeup(size_t events);
+
+// Print p50/p99/max of all stages
+void trace_dump(FILE *f);
+// Atomically replace path with current stats
+void trace_write(const char *path);
+// Current monotonic time in us, same clock as libinput timestamps
+uint64_t trace_now(void);
+#endif
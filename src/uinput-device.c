@@ -0,0 +1,270 @@
+#include "uinput-device.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define COMBO_KEYS 8  // most keys pressed together
+
+typedef struct key_name {
+	const char *name;
+	unsigned short code;
+} key_name;
+
+static const key_name keys[] = {
+	{"ctrl", KEY_LEFTCTRL}, {"control", KEY_LEFTCTRL}, {"shift", KEY_LEFTSHIFT},
+	{"alt", KEY_LEFTALT}, {"altgr", KEY_RIGHTALT}, {"super", KEY_LEFTMETA},
+	{"meta", KEY_LEFTMETA}, {"win", KEY_LEFTMETA},
+	{"a", KEY_A}, {"b", KEY_B}, {"c", KEY_C}, {"d", KEY_D}, {"e", KEY_E},
+	{"f", KEY_F}, {"g", KEY_G}, {"h", KEY_H}, {"i", KEY_I}, {"j", KEY_J},
+	{"k", KEY_K}, {"l", KEY_L}, {"m", KEY_M}, {"n", KEY_N}, {"o", KEY_O},
+	{"p", KEY_P}, {"q", KEY_Q}, {"r", KEY_R}, {"s", KEY_S}, {"t", KEY_T},
+	{"u", KEY_U}, {"v", KEY_V}, {"w", KEY_W}, {"x", KEY_X}, {"y", KEY_Y},
+	{"z", KEY_Z},
+	{"1", KEY_1}, {"2", KEY_2}, {"3", KEY_3}, {"4", KEY_4}, {"5", KEY_5},
+	{"6", KEY_6}, {"7", KEY_7}, {"8", KEY_8}, {"9", KEY_9}, {"0", KEY_0},
+	{"f1", KEY_F1}, {"f2", KEY_F2}, {"f3", KEY_F3}, {"f4", KEY_F4},
+	{"f5", KEY_F5}, {"f6", KEY_F6}, {"f7", KEY_F7}, {"f8", KEY_F8},
+	{"f9", KEY_F9}, {"f10", KEY_F10}, {"f11", KEY_F11}, {"f12", KEY_F12},
+	{"escape", KEY_ESC}, {"esc", KEY_ESC}, {"tab", KEY_TAB},
+	{"return", KEY_ENTER}, {"enter", KEY_ENTER}, {"space", KEY_SPACE},
+	{"backspace", KEY_BACKSPACE}, {"delete", KEY_DELETE}, {"insert", KEY_INSERT},
+	{"home", KEY_HOME}, {"end", KEY_END}, {"pageup", KEY_PAGEUP},
+	{"pagedown", KEY_PAGEDOWN}, {"up", KEY_UP}, {"down", KEY_DOWN},
+	{"left", KEY_LEFT}, {"right", KEY_RIGHT}, {"print", KEY_SYSRQ},
+	{"minus", KEY_MINUS}, {"equal", KEY_EQUAL}, {"comma", KEY_COMMA},
+	{"period", KEY_DOT}, {"slash", KEY_SLASH},
+	{"volumeup", KEY_VOLUMEUP}, {"volumedown", KEY_VOLUMEDOWN}, {"mute", KEY_MUTE},
+	{"playpause", KEY_PLAYPAUSE}, {"next", KEY_NEXTSONG}, {"previous", KEY_PREVIOUSSONG},
+	{"brightnessup", KEY_BRIGHTNESSUP}, {"brightnessdown", KEY_BRIGHTNESSDOWN},
+};
+
+static int fd = -1;
+
+bool uinput_open(void) {
+	struct uinput_setup setup = {.id = {.bustype = BUS_VIRTUAL}};
+	if (fd >= 0) {
+		return true;
+	}
+	if ((fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC)) == -1) {
+		printf("Failed to open /dev/uinput: %s\n", strerror(errno));
+		return false;
+	}
+	ioctl(fd, UI_SET_EVBIT, EV_KEY);
+	ioctl(fd, UI_SET_EVBIT, EV_REL);
+	// all keyboard keys, so that keys can also be given by code
+	for (int code = KEY_ESC; code <= KEY_MICMUTE; code++) {
+		ioctl(fd, UI_SET_KEYBIT, code);
+	}
+	ioctl(fd, UI_SET_KEYBIT, BTN_LEFT);
+	ioctl(fd, UI_SET_KEYBIT, BTN_MIDDLE);
+	ioctl(fd, UI_SET_KEYBIT, BTN_RIGHT);
+	// pointer axes, so that it is handled as a mouse
+	ioctl(fd, UI_SET_RELBIT, REL_X);
+	ioctl(fd, UI_SET_RELBIT, REL_Y);
+	ioctl(fd, UI_SET_RELBIT, REL_WHEEL);
+	ioctl(fd, UI_SET_RELBIT, REL_HWHEEL);
+	strncpy(setup.name, UINPUT_NAME, UINPUT_MAX_NAME_SIZE - 1);
+	if (ioctl(fd, UI_DEV_SETUP, &setup) == -1 || ioctl(fd, UI_DEV_CREATE) == -1) {
+		printf("Failed to create uinput device: %s\n", strerror(errno));
+		close(fd);
+		fd = -1;
+		return false;
+	}
+	return true;
+}
+
+// append an event, false if the batch is full
+static bool push(struct input_event *ev, size_t *n, unsigned short type, unsigned short code, int value) {
+	if (*n == UINPUT_MAX_EVENTS) {
+		return false;
+	}
+	ev[(*n)++] = (struct input_event){.type = type, .code = code, .value = value};
+	return true;
+}
+
+static bool syn(struct input_event *ev, size_t *n) {
+	return push(ev, n, EV_SYN, SYN_REPORT, 0);
+}
+
+// the kernel stamps the events, so the batch goes out as is
+static int flush(const struct input_event *ev, size_t n) {
+	if (!uinput_open()) {
+		return -1;
+	}
+	if (write(fd, ev, n * sizeof *ev) != (ssize_t)(n * sizeof *ev)) {
+		printf("Failed to write uinput events: %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int key_code(const char *name) {
+	char *end;
+	long code;
+	for (size_t i = 0; i < sizeof keys / sizeof *keys; i++) {
+		if (strcasecmp(name, keys[i].name) == 0) {
+			return keys[i].code;
+		}
+	}
+	// other keys by their evdev code
+	code = strtol(name, &end, 0);
+	if (*end != '\0' || code < KEY_ESC || code > KEY_MICMUTE) {
+		return -1;
+	}
+	return code;
+}
+
+// whether the first word of arg is word
+static bool first_word(const char *arg, const char *word) {
+	size_t len = strcspn(arg, " ");
+	return len == strlen(word) && strncmp(arg, word, len) == 0;
+}
+
+// count after the first word, 1 if there is none, 0 if it is no number
+// between 1 and UINPUT_MAX_EVENTS
+static int repeat(const char *arg) {
+	const char *rest = arg + strcspn(arg, " ");
+	char *end;
+	long n;
+	rest += strspn(rest, " ");
+	if (*rest == '\0') {
+		return 1;
+	}
+	n = strtol(rest, &end, 10);
+	end += strspn(end, " ");
+	return end != rest && *end == '\0' && n > 0 && n <= UINPUT_MAX_EVENTS ? n : 0;
+}
+
+// build the events of key combos, 0 if they are malformed
+static size_t parse_key(const char *combos, struct input_event *ev) {
+	char buffer[256], *combo, *key, *save, *savekey;
+	int codes[COMBO_KEYS], k;
+	size_t n = 0, len;
+	strncpy(buffer, combos, sizeof buffer - 1);
+	buffer[sizeof buffer - 1] = '\0';
+	for (combo = strtok_r(buffer, " \t", &save); combo; combo = strtok_r(NULL, " \t", &save)) {
+		len = 0;
+		for (key = strtok_r(combo, "+", &savekey); key; key = strtok_r(NULL, "+", &savekey)) {
+			if (len == COMBO_KEYS || (k = key_code(key)) < 0) {
+				printf("Invalid key combo %s\n", combos);
+				return 0;
+			}
+			codes[len++] = k;
+		}
+		// press in order, release in reverse
+		for (size_t i = 0; i < len; i++) {
+			push(ev, &n, EV_KEY, codes[i], 1);
+		}
+		syn(ev, &n);
+		for (size_t i = len; i > 0; i--) {
+			push(ev, &n, EV_KEY, codes[i - 1], 0);
+		}
+		if (!syn(ev, &n)) {
+			printf("Too many keys in %s\n", combos);
+			return 0;
+		}
+	}
+	if (n == 0) {
+		printf("Missing key combo\n");
+	}
+	return n;
+}
+
+// build the events of clicks, 0 if the button or count is malformed
+static size_t parse_click(const char *button, struct input_event *ev) {
+	size_t n = 0;
+	int count = repeat(button), code;
+	if (first_word(button, "left") || first_word(button, "1")) {
+		code = BTN_LEFT;
+	} else if (first_word(button, "middle") || first_word(button, "2")) {
+		code = BTN_MIDDLE;
+	} else if (first_word(button, "right") || first_word(button, "3")) {
+		code = BTN_RIGHT;
+	} else {
+		code = -1;
+	}
+	if (code < 0 || count == 0) {
+		printf("Invalid button %s\n", button);
+		return 0;
+	}
+	for (int i = 0; i < count; i++) {
+		push(ev, &n, EV_KEY, code, 1);
+		syn(ev, &n);
+		push(ev, &n, EV_KEY, code, 0);
+		if (!syn(ev, &n)) {
+			break;
+		}
+	}
+	return n;
+}
+
+// build the events of a scroll, 0 if the direction or steps are malformed
+static size_t parse_scroll(const char *steps, struct input_event *ev) {
+	size_t n = 0;
+	int count = repeat(steps);
+	if (count == 0) {
+		// no steps, so no event is pushed
+	} else if (first_word(steps, "up")) {
+		push(ev, &n, EV_REL, REL_WHEEL, count);
+	} else if (first_word(steps, "down")) {
+		push(ev, &n, EV_REL, REL_WHEEL, -count);
+	} else if (first_word(steps, "left")) {
+		push(ev, &n, EV_REL, REL_HWHEEL, -count);
+	} else if (first_word(steps, "right")) {
+		push(ev, &n, EV_REL, REL_HWHEEL, count);
+	}
+	if (n == 0) {
+		printf("Invalid scroll %s\n", steps);
+		return 0;
+	}
+	syn(ev, &n);
+	return n;
+}
+
+bool uinput_check_key(const char *combos) {
+	struct input_event ev[UINPUT_MAX_EVENTS];
+	return parse_key(combos, ev) > 0;
+}
+
+bool uinput_check_click(const char *button) {
+	struct input_event ev[UINPUT_MAX_EVENTS];
+	return parse_click(button, ev) > 0;
+}
+
+bool uinput_check_scroll(const char *steps) {
+	struct input_event ev[UINPUT_MAX_EVENTS];
+	return parse_scroll(steps, ev) > 0;
+}
+
+int uinput_key(const char *combos) {
+	struct input_event ev[UINPUT_MAX_EVENTS];
+	size_t n = parse_key(combos, ev);
+	return n ? flush(ev, n) : -1;
+}
+
+int uinput_click(const char *button) {
+	struct input_event ev[UINPUT_MAX_EVENTS];
+	size_t n = parse_click(button, ev);
+	return n ? flush(ev, n) : -1;
+}
+
+int uinput_scroll(const char *steps) {
+	struct input_event ev[UINPUT_MAX_EVENTS];
+	size_t n = parse_scroll(steps, ev);
+	return n ? flush(ev, n) : -1;
+}
+
+void uinput_close(void) {
+	if (fd < 0) {
+		return;
+	}
+	ioctl(fd, UI_DEV_DESTROY);
+	close(fd);
+	fd = -1;
+}
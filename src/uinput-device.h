@@ -0,0 +1,26 @@
+#ifndef UINPUT_DEVICE_H
+#define UINPUT_DEVICE_H
+#include <stdbool.h>
+#define UINPUT_NAME "libinput-touchscreen-gestures"  // name of the virtual device
+#define UINPUT_MAX_EVENTS 128  // most input events written per action
+
+// Synthetic key, button and scroll events through a /dev/uinput device that
+// is created once and stays open, so they work below X11 and Wayland alike.
+// The events of an action are written with a single write.
+
+// Create the virtual device if not created, false on errors
+bool uinput_open(void);
+// Check the arguments of uinput_key, uinput_click and uinput_scroll without
+// writing events, false with a message if they are malformed
+bool uinput_check_key(const char *combos);
+bool uinput_check_click(const char *button);
+bool uinput_check_scroll(const char *steps);
+// Press and release key combos "ctrl+alt+t [<combo> ...]"
+int uinput_key(const char *combos);
+// Click "<left|middle|right|1|2|3> [count]", numbers as in xdotool
+int uinput_click(const char *button);
+// Scroll "<up|down|left|right> [steps]"
+int uinput_scroll(const char *steps);
+// Destroy the virtual device
+void uinput_close(void);
+#endif
@@ -0,0 +1,76 @@
+#include "update.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct update {
+	const rule *r;  // NULL for an unused entry
+	double delta;  // sum of deltas not yet sent
+	bool pending;
+	uint64_t last;  // time in us the last update was sent
+} update;
+
+static update updates[UPDATE_MAX];
+
+static uint64_t interval(const rule *r) {
+	return 1000000 / (r->rate > 0 ? r->rate : UPDATE_DEFAULT_RATE);
+}
+
+void update_add(const rule *r, double delta, uint64_t now) {
+	update *u, *unused = NULL;
+	for (size_t i = 0; i < UPDATE_MAX; i++) {
+		u = updates + i;
+		if (u->r == r) {
+			u->delta = u->pending ? u->delta + delta : delta;
+			u->pending = true;
+			return;
+		}
+		// entries can be reused once their rate limit no longer applies
+		if (unused == NULL && (u->r == NULL || (!u->pending && u->last + interval(u->r) <= now))) {
+			unused = u;
+		}
+	}
+	if (unused == NULL) {
+		logger("Dropping update, too many pending\n");
+		return;
+	}
+	*unused = (update){.r = r, .delta = delta, .pending = true};
+}
+
+bool update_next(uint64_t now, const rule **r, double *delta) {
+	update *u;
+	for (size_t i = 0; i < UPDATE_MAX; i++) {
+		u = updates + i;
+		if (u->pending && u->last + interval(u->r) <= now) {
+			u->pending = false;
+			u->last = now;
+			*r = u->r;
+			*delta = u->delta;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint64_t update_deadline(void) {
+	uint64_t next = UINT64_MAX, due;
+	for (size_t i = 0; i < UPDATE_MAX; i++) {
+		if (updates[i].pending && (due = updates[i].last + interval(updates[i].r)) < next) {
+			next = due;
+		}
+	}
+	return next;
+}
+
+void update_clear(void) {
+	memset(updates, 0, sizeof updates);
+}
+
+void update_command(char *out, size_t size, const char *command, double delta) {
+	const char *var = strstr(command, "{delta}");
+	if (var == NULL) {
+		snprintf(out, size, "%s", command);
+		return;
+	}
+	snprintf(out, size, "%.*s%.3f%s", (int)(var - command), command, delta, var + strlen("{delta}"));
+}
@@ -0,0 +1,24 @@
+#ifndef UPDATE_H
+#define UPDATE_H
+#include "libinput-touchscreen.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#define UPDATE_MAX 16  // rules with pending updates at once
+#define UPDATE_DEFAULT_RATE 10.0f  // updates per second of rules without rate option
+
+// Continuous gestures produce a delta per touch frame. Deltas of a rule are
+// summed into a single pending update, which is sent at most rate times per
+// second, so fast digitizers do not launch a command per frame.
+
+// Add delta to the pending update of a rule, time in us
+void update_add(const rule *r, double delta, uint64_t now);
+// Take a pending update due at now, false if none is due
+bool update_next(uint64_t now, const rule **r, double *delta);
+// Time in us the next pending update is due, UINT64_MAX if none
+uint64_t update_deadline(void);
+// Drop all pending updates, before the rules they belong to are freed
+void update_clear(void);
+// Command of a rule with {delta} replaced by the delta
+void update_command(char *out, size_t size, const char *command, double delta);
+#endif
@@ -0,0 +1,34 @@
+#include "zone.h"
+
+#include <stdlib.h>
+
+// cell index of a screen fraction, clamped to the grid
+static size_t cell(float f) {
+	int i = f * ZONE_GRID;
+	return i < 0 ? 0 : i >= ZONE_GRID ? ZONE_GRID - 1 : i;
+}
+
+zone_grid *zone_grid_new(const zone *zones, size_t n) {
+	zone_grid *g = calloc(1, sizeof *g);
+	float cx, cy;
+	for (size_t row = 0; row < ZONE_GRID; row++) {
+		cy = (row + 0.5f) / ZONE_GRID;
+		for (size_t col = 0; col < ZONE_GRID; col++) {
+			cx = (col + 0.5f) / ZONE_GRID;
+			for (size_t i = 0; i < n && i < ZONE_MAX; i++) {
+				if (cx >= zones[i].x0 && cx <= zones[i].x1 && cy >= zones[i].y0 && cy <= zones[i].y1) {
+					g->cells[row][col] |= (zonemask)1 << i;
+				}
+			}
+		}
+	}
+	// zones narrower than a cell still get the cell of their center
+	for (size_t i = 0; i < n && i < ZONE_MAX; i++) {
+		g->cells[cell((zones[i].y0 + zones[i].y1) / 2)][cell((zones[i].x0 + zones[i].x1) / 2)] |= (zonemask)1 << i;
+	}
+	return g;
+}
+
+zonemask zone_lookup(const zone_grid *g, float fx, float fy) {
+	return g->cells[cell(fy)][cell(fx)];
+}
@@ -0,0 +1,31 @@
+#ifndef ZONE_H
+#define ZONE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#define ZONE_MAX 32  // most zones a config can declare, one bit each in a zonemask
+#define ZONE_GRID 128  // cells per screen axis of the lookup grid
+
+// bit i set for zone i
+typedef uint32_t zonemask;
+
+// Rectangle of the calibrated screen in fractions of its width and height
+typedef struct zone {
+	float x0, y0;
+	float x1, y1;
+} zone;
+
+// Zones are compiled into a grid over the calibrated screen holding the
+// zones of every cell, so the zones of a point are found with one lookup
+// regardless of how many are defined. A cell belongs to a zone if its
+// center lies inside it, or if it holds the center of the zone.
+typedef struct zone_grid {
+	zonemask cells[ZONE_GRID][ZONE_GRID];  // by row, then column
+} zone_grid;
+
+// Compile n zones into a grid
+zone_grid *zone_grid_new(const zone *zones, size_t n);
+// Zones containing the point at fractions fx, fy of the screen, points
+// outside count as on the closest border
+zonemask zone_lookup(const zone_grid *g, float fx, float fy);
+#endif